@@ -1,5 +1,7 @@
 #include "bitmap.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // converts a block index to an index in the array,
 // and a uint8_t that indicates the offset of the bit inside the array.
@@ -31,55 +33,305 @@ uint8_t BitMap_isBitSet(BitMap* bmap, int block_num) {
 // returns the pos of the first bit equal to status in a byte called num
 // returns -1 in case of bit not found
 int BitMap_check(uint8_t num, int status) {
-	if (num < 0) return ERROR_RESEARCH_FAULT;
-	int i = 7;
-	while (i >= 0) {
-		if (status != 0 && (num & (1 << i))) {
-			return (NUMBITS - 1 - i);			
-		}
-		else if (status == 0 && !(num & (1 << i))) {
-			return (NUMBITS -1 - i);
-		}	
+	// Looking for a FREE bit is like looking for an OCCUPIED bit in the complement.
+	// Bits are MSB-first, so the position is the number of leading zeros in the byte
+	unsigned int bits = status ? num : (uint8_t) ~num;
+	if (bits == 0) return ERROR_RESEARCH_FAULT;
+	return __builtin_clz(bits) - (sizeof(unsigned int) - 1) * NUMBITS;
+}
+
+// loads the 8 entries starting from p in a 64 bit word.
+// The word is big endian, so that the first bit of the bitmap (MSB of p[0])
+// is the MSB of the word and the order of the bits is preserved
+static inline uint64_t BitMap_loadWord(const uint8_t* p) {
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+	return word;
+}
+
+// word-at-a-time search kernel.
+// Full words that can't contain the wanted bit (all ones if looking for a FREE bit,
+// all zeroes if looking for an OCCUPIED one) are skipped with a single compare,
+// then the position in the first useful word is given by count leading zeros.
+// The entries that don't fill a whole word are checked one at a time
+static int BitMap_getWord(BitMap* bmap, int start, int status) {
+	const uint8_t* entries = bmap->entries;
+	int64_t num_entries = bmap->num_bits;
+	uint64_t skip = status ? 0 : ~(uint64_t) 0;
 	
-		--i;
+	int i = start;
+	while (i + (int) sizeof(uint64_t) <= num_entries) {
+		uint64_t word = BitMap_loadWord(entries + i);
+		if (word != skip) {
+			uint64_t bits = status ? word : ~word;
+			return i * NUMBITS + __builtin_clzll(bits);
+		}
+		i += sizeof(uint64_t);
+	}
+	while (i < num_entries) {
+		int pos = BitMap_check(entries[i], status);
+		if (pos != ERROR_RESEARCH_FAULT) return (i * NUMBITS + pos);
+		i++;
 	}
 	return ERROR_RESEARCH_FAULT;
 }
 
+#if BITMAP_X86_KERNELS
+// AVX2 search kernel.
+// Compares 32 entries at a time against the byte to skip: the first entry that
+// differs is the one holding the wanted bit. What's left is done by the word kernel
+static __attribute__((target("avx2"))) int BitMap_getAVX2(BitMap* bmap, int start, int status) {
+	const uint8_t* entries = bmap->entries;
+	int64_t num_entries = bmap->num_bits;
+	const __m256i skip = _mm256_set1_epi8(status ? 0 : (char) 0xFF);
+	
+	int i = start;
+	while (i + (int) sizeof(__m256i) <= num_entries) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i*) (entries + i));
+		unsigned int equal = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, skip));
+		if (equal != 0xFFFFFFFFu) {
+			int entry = i + __builtin_ctz(~equal);
+			return entry * NUMBITS + BitMap_check(entries[entry], status);
+		}
+		i += sizeof(__m256i);
+	}
+	return BitMap_getWord(bmap, i, status);
+}
+#endif
+
+// counts the OCCUPIED bits in the bitmap a 64 bit word at a time.
+// Built as a generic and as a popcnt kernel: the first one works on every CPU,
+// the second one makes __builtin_popcountll a single instruction
+#define BITMAP_COUNT_KERNEL(name, attributes) \
+static attributes int64_t name(BitMap* bmap) { \
+	const uint8_t* entries = bmap->entries; \
+	int64_t num_entries = bmap->num_bits; \
+	int64_t count = 0; \
+	int64_t i = 0; \
+	while (i + (int) sizeof(uint64_t) <= num_entries) { \
+		uint64_t word; \
+		memcpy(&word, entries + i, sizeof(word)); \
+		count += __builtin_popcountll(word); \
+		i += sizeof(uint64_t); \
+	} \
+	while (i < num_entries) { \
+		count += __builtin_popcount(entries[i]); \
+		i++; \
+	} \
+	return count; \
+}
+
+BITMAP_COUNT_KERNEL(BitMap_countWord, )
+#if BITMAP_X86_KERNELS
+BITMAP_COUNT_KERNEL(BitMap_countPopcnt, __attribute__((target("popcnt"))))
+#endif
+
+// kernels used by BitMap_get() and BitMap_getFreeBlocks(), chosen at the first call
+static int (*BitMap_getKernel)(BitMap* bmap, int start, int status) = NULL;
+static int64_t (*BitMap_countKernel)(BitMap* bmap) = NULL;
+
+// picks the fastest kernels supported by the running CPU
+static void BitMap_selectKernel(void) {
+	BitMap_getKernel = BitMap_getWord;
+	BitMap_countKernel = BitMap_countWord;
+#if BITMAP_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) BitMap_getKernel = BitMap_getAVX2;
+	if (__builtin_cpu_supports("popcnt")) BitMap_countKernel = BitMap_countPopcnt;
+#endif
+}
+
+// loads the word with index w of the bitmap.
+// The last word can be shorter than 8 entries: the missing ones are replaced by pad
+static inline uint64_t BitMap_summaryWord(BitMap* bmap, int w, uint8_t pad) {
+	int first = w * sizeof(uint64_t);
+	if (first + (int) sizeof(uint64_t) <= bmap->num_bits) return BitMap_loadWord(bmap->entries + first);
+	uint8_t tail[sizeof(uint64_t)];
+	memset(tail, pad, sizeof(tail));
+	memcpy(tail, bmap->entries + first, bmap->num_bits - first);
+	return BitMap_loadWord(tail);
+}
+
+// returns the index of the first bit equal to 0 at the given level,
+// starting from the bit with index pos. -1 if there isn't one.
+// When the rest of the word is all ones the upper level tells which is the next word with a 0
+static int BitMap_summaryFind(BitMapSummary* summary, BitMapLevel* levels, int level, int pos) {
+	BitMapLevel* current = &levels[level];
+	int w = pos / SUMMARY_WORD_BITS;
+	if (w >= current->num_words) return ERROR_RESEARCH_FAULT;
+	
+	uint64_t zeroes = ~current->words[w] & (~(uint64_t) 0 << (pos % SUMMARY_WORD_BITS));
+	if (zeroes) return w * SUMMARY_WORD_BITS + __builtin_ctzll(zeroes);
+	
+	int next = ERROR_RESEARCH_FAULT;
+	if (level + 1 < summary->num_levels) {
+		next = BitMap_summaryFind(summary, levels, level + 1, w + 1);
+	}
+	else {
+		for (int i = w + 1; i < current->num_words; ++i) {
+			if (~current->words[i]) {
+				next = i;
+				break;
+			}
+		}
+	}
+	if (next == ERROR_RESEARCH_FAULT) return ERROR_RESEARCH_FAULT;
+	return next * SUMMARY_WORD_BITS + __builtin_ctzll(~current->words[next]);
+}
+
+// sets (done != 0) or clears the bit with index index of level 0,
+// then goes up while the word it belongs to changes from/to all ones
+static void BitMap_summaryMark(BitMapSummary* summary, BitMapLevel* levels, int index, int done) {
+	for (int level = 0; level < summary->num_levels; ++level) {
+		uint64_t* word = &levels[level].words[index / SUMMARY_WORD_BITS];
+		int was_done = (*word == ~(uint64_t) 0);
+		uint64_t bit = (uint64_t) 1 << (index % SUMMARY_WORD_BITS);
+		if (done) *word |= bit;
+		else *word &= ~bit;
+		int is_done = (*word == ~(uint64_t) 0);
+		if (was_done == is_done) return;
+		done = is_done;
+		index /= SUMMARY_WORD_BITS;
+	}
+}
+
+// looks for the first bit having status "status" from the bit with index start using the summary.
+// The word holding start is checked directly, the next useful word is given by the summary
+static int BitMap_summaryGet(BitMap* bmap, int start, int status) {
+	BitMapSummary* summary = bmap->summary;
+	BitMapLevel* levels = status ? summary->empty : summary->full;
+	uint8_t pad = status ? 0 : 0xFF;
+	
+	int w = start / SUMMARY_WORD_BITS;
+	uint64_t word = BitMap_summaryWord(bmap, w, pad);
+	uint64_t bits = (status ? word : ~word) & (~(uint64_t) 0 >> (start % SUMMARY_WORD_BITS));
+	if (bits) return w * SUMMARY_WORD_BITS + __builtin_clzll(bits);
+	
+	w = BitMap_summaryFind(summary, levels, 0, w + 1);
+	if (w == ERROR_RESEARCH_FAULT) return ERROR_RESEARCH_FAULT;
+	word = BitMap_summaryWord(bmap, w, pad);
+	bits = status ? word : ~word;
+	return w * SUMMARY_WORD_BITS + __builtin_clzll(bits);
+}
+
 // returns the index of the first bit having status "status"
 // in the bitmap bmap, and starts looking from position start.
 // for humans: returns the global position of that bit we're looking for
 // starting by the bitmap cell with index "start".
 int BitMap_get(BitMap* bmap, int start, int status) {
-	int i = start;
-	while (i < bmap->num_bits) {
-		int pos = BitMap_check((bmap->entries)[i], status);
-		if (pos != ERROR_RESEARCH_FAULT) return (i * NUMBITS + pos);
-		i++;
+	if (start < 0) start = 0;
+	if (start >= bmap->num_bits) return ERROR_RESEARCH_FAULT;
+	if (bmap->summary != NULL) return BitMap_summaryGet(bmap, start * NUMBITS, status != 0);
+	if (BitMap_getKernel == NULL) BitMap_selectKernel();
+	return BitMap_getKernel(bmap, start, status != 0);
+}
+
+// same as BitMap_get, but start is the index of a bit and not of a bitmap cell
+int BitMap_getBit(BitMap* bmap, int start, int status) {
+	if (start < 0) start = 0;
+	if (start >= bmap->num_bits * NUMBITS) return ERROR_RESEARCH_FAULT;
+	if (bmap->summary != NULL) return BitMap_summaryGet(bmap, start, status != 0);
+	
+	// Without summary: the first cell is checked bit by bit, the others by BitMap_get
+	for (int pos = start; pos % NUMBITS != 0; ++pos) {
+		if ((BitMap_isBitSet(bmap, pos) != 0) == (status != 0)) return pos;
+	}
+	return BitMap_get(bmap, (start + NUMBITS - 1) / NUMBITS, status);
+}
+
+// returns the index of the first bit of a run of at least len FREE bits,
+// looking from the bit with index start.
+// returns -1 if there is no such run
+int BitMap_getRun(BitMap* bmap, int start, int len) {
+	int64_t tot_bits = bmap->num_bits * NUMBITS;
+	int64_t pos = start;
+	while (pos < tot_bits) {
+		// The run starts at the first FREE bit and ends at the first OCCUPIED one after it
+		int first = BitMap_getBit(bmap, pos, FREE);
+		if (first == ERROR_RESEARCH_FAULT) return ERROR_RESEARCH_FAULT;
+		int64_t end = BitMap_getBit(bmap, first, OCCUPIED);
+		if (end == ERROR_RESEARCH_FAULT) end = tot_bits;
+		if (end - first >= len) return first;
+		pos = end;
 	}
 	return ERROR_RESEARCH_FAULT;
 }
 
 // sets the bit in bmap at index pos in the blocks list to status
+// keeps the summary (if any) up to date
 int BitMap_set(BitMap* bmap, int pos, int status) {
 	int array_index = pos / NUMBITS;
 	int offset = pos % NUMBITS;
+	int ret;
 	if (status) {
-		return (bmap->entries)[array_index] |= (status << (NUMBITS -1 - offset));
+		ret = (bmap->entries)[array_index] |= (status << (NUMBITS -1 - offset));
+	}
+	else {
+		ret = (bmap->entries)[array_index] &= ~(1 << (NUMBITS -1 - offset));
 	}
-	else if (!status) {
-		return (bmap->entries)[array_index] &= ~(1 << (NUMBITS -1 - offset));
+	
+	if (bmap->summary != NULL) {
+		int w = pos / SUMMARY_WORD_BITS;
+		BitMap_summaryMark(bmap->summary, bmap->summary->full, w, BitMap_summaryWord(bmap, w, 0xFF) == ~(uint64_t) 0);
+		BitMap_summaryMark(bmap->summary, bmap->summary->empty, w, BitMap_summaryWord(bmap, w, 0) == 0);
 	}
-	else
-		return ERROR_RESEARCH_FAULT;
+	return ret;
 }
 
-// gets all the free bits of the bitmap
-int BitMap_getFreeBlocks(BitMap* bmap) {
-	int count = 0;
-	int tot_bits = bmap->num_bits * NUMBITS;
-	for (int i = 0; i < tot_bits; ++i) {
-		if (!BitMap_isBitSet(bmap, i)) ++count;
+// builds the summary of the bitmap from its entries
+void BitMap_buildSummary(BitMap* bmap) {
+	BitMap_freeSummary(bmap);
+	BitMapSummary* summary = (BitMapSummary*) malloc(sizeof(BitMapSummary));
+	
+	// Every level has a bit for each word of the level below, the last one fits in a word.
+	// The bits after the end of a level are set, so they're never looked at
+	int below = (bmap->num_bits + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+	int level = 0;
+	do {
+		int num_words = (below + SUMMARY_WORD_BITS - 1) / SUMMARY_WORD_BITS;
+		BitMapLevel* levels[] = { &summary->full[level], &summary->empty[level] };
+		for (int i = 0; i < 2; ++i) {
+			levels[i]->num_words = num_words;
+			levels[i]->words = (uint64_t*) malloc(num_words * sizeof(uint64_t));
+			memset(levels[i]->words, 0, num_words * sizeof(uint64_t));
+			for (int bit = below; bit < num_words * SUMMARY_WORD_BITS; ++bit) {
+				levels[i]->words[bit / SUMMARY_WORD_BITS] |= (uint64_t) 1 << (bit % SUMMARY_WORD_BITS);
+			}
+		}
+		below = num_words;
+		++level;
+	} while (below > 1 && level < SUMMARY_MAX_LEVELS);
+	summary->num_levels = level;
+	
+	// Filling level 0 from the bitmap, the others from level 0
+	int num_words = (bmap->num_bits + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+	for (int w = 0; w < num_words; ++w) {
+		if (BitMap_summaryWord(bmap, w, 0xFF) == ~(uint64_t) 0) {
+			BitMap_summaryMark(summary, summary->full, w, 1);
+		}
+		if (BitMap_summaryWord(bmap, w, 0) == 0) {
+			BitMap_summaryMark(summary, summary->empty, w, 1);
+		}
+	}
+	bmap->summary = summary;
+}
+
+// destroys the summary of the bitmap
+void BitMap_freeSummary(BitMap* bmap) {
+	if (bmap->summary == NULL) return;
+	for (int level = 0; level < bmap->summary->num_levels; ++level) {
+		free(bmap->summary->full[level].words);
+		free(bmap->summary->empty[level].words);
 	}
-	return count;
+	free(bmap->summary);
+	bmap->summary = NULL;
+}
+
+// gets all the free bits of the bitmap
+int64_t BitMap_getFreeBlocks(BitMap* bmap) {
+	if (BitMap_countKernel == NULL) BitMap_selectKernel();
+	return bmap->num_bits * NUMBITS - BitMap_countKernel(bmap);
 }
@@ -1,6 +1,15 @@
 #pragma once
 #include <stdint.h>
 
+// The AVX2 search kernel and the popcnt count kernel are built only on x86 with GCC/Clang.
+// They're used only if the running CPU supports them (checked at runtime)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITMAP_X86_KERNELS	1
+#include <immintrin.h>
+#else
+#define BITMAP_X86_KERNELS	0
+#endif
+
 // Errors
 #define ERROR_RESEARCH_FAULT	-1
 
@@ -9,9 +18,32 @@
 #define FREE		0
 #define NUMBITS		8
 
+// Summary levels
+#define SUMMARY_WORD_BITS	64	// bits in a word of the bitmap and of each summary level
+#define SUMMARY_MAX_LEVELS	6	// enough for 2^31 bits
+
+// A level of a summary: it has a bit for each word of the level below
+// (level 0 has a bit for each 64 bits word of the bitmap)
+typedef struct {
+	int num_words;
+	uint64_t* words;
+} BitMapLevel;
+
+// Hierarchical summary of a bitmap. It lives only in memory.
+// In full a bit is set if the word below has all the bits OCCUPIED,
+// in empty a bit is set if the word below has all the bits FREE.
+// Levels are added until one of them fits in a single word, so looking for
+// a FREE (OCCUPIED) bit skips the full (empty) words touching a word per level
+typedef struct {
+	int num_levels;
+	BitMapLevel full[SUMMARY_MAX_LEVELS];
+	BitMapLevel empty[SUMMARY_MAX_LEVELS];
+} BitMapSummary;
+
 typedef struct {
-	int num_bits;		// WARNING: THIS IS THE ARRAY DIMENSION. THE NUMBER OF BITS IS num_bits * NUMBITS
+	int64_t num_bits;	// WARNING: THIS IS THE ARRAY DIMENSION. THE NUMBER OF BITS IS num_bits * NUMBITS
 	uint8_t* entries;
+	BitMapSummary* summary;	// NULL if the summary is not built
 }  BitMap;
 
 typedef struct {
@@ -38,13 +70,31 @@ int BitMap_check(uint8_t num, int status);
 // in the bitmap bmap, and starts looking from position start.
 // for humans: returns the global position in the bitmap of that bit we're looking for
 // starting by the bitmap cell with index "start".
+// Uses the summary if built, else skips whole words of useless bits
+// at a time (AVX2 if the CPU has it)
 int BitMap_get(BitMap* bmap, int start, int status);
 
+// same as BitMap_get, but start is the index of a bit and not of a bitmap cell
+int BitMap_getBit(BitMap* bmap, int start, int status);
+
+// returns the index of the first bit of a run of at least len FREE bits,
+// looking from the bit with index start.
+// returns -1 if there is no such run
+int BitMap_getRun(BitMap* bmap, int start, int len);
+
 // sets the bit in bmap at index pos in the blocks list to status
+// keeps the summary (if any) up to date
 int BitMap_set(BitMap* bmap, int pos, int status);
 
+// builds the summary of the bitmap from its entries
+void BitMap_buildSummary(BitMap* bmap);
+
+// destroys the summary of the bitmap
+void BitMap_freeSummary(BitMap* bmap);
+
 // gets all the free bits of the bitmap
-int BitMap_getFreeBlocks(BitMap* bmap);
+// (counts the occupied ones with popcount, 64 bits at a time)
+int64_t BitMap_getFreeBlocks(BitMap* bmap);
 
 /*	NOTES
 *	Changed char with uint8_t to avoid mistakes
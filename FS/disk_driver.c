@@ -1,15 +1,85 @@
 #include "disk_driver.h"
 
+// returns the offset of the first block in the map of a disk of num_blocks blocks:
+// after the header and the bitmap entries array, rounded up to the block size
+// so that every block is aligned to its size (a 4 KiB block is a page)
+static inline size_t AUX_blocklist_start(int64_t num_blocks, int block_size) {
+	size_t start = sizeof(DiskHeader) + (size_t) (num_blocks / NUMBITS + 1);
+	return (start + block_size - 1) & ~((size_t) block_size - 1);
+}
+
+// returns the size of the map of a disk of num_blocks blocks:
+// the header, the bitmap entries array and the blocks.
+// (computed on 64 bits: num_blocks * block_size doesn't fit an int on big disks)
+static inline size_t AUX_map_dim(int64_t num_blocks, int block_size) {
+	return AUX_blocklist_start(num_blocks, block_size) + (size_t) num_blocks * block_size;
+}
+
+// returns log2 of block_size, -1 if it's not a power of two from BLOCK_SIZE_MIN to BLOCK_SIZE_MAX
+static int AUX_block_shift(int block_size) {
+	if (block_size < BLOCK_SIZE_MIN || block_size > BLOCK_SIZE_MAX) return ERROR_FILE_FAULT;
+	if (block_size & (block_size - 1)) return ERROR_FILE_FAULT;
+	return __builtin_ctz(block_size);
+}
+
+// counts the free blocks of every allocation group from the bitmap.
+// A group is a whole number of bitmap cells, so its slice is counted a cell at a time
+static void AUX_groups_count(DiskDriver* disk) {
+	int64_t num_blocks = disk->header->num_blocks;
+	int64_t group_blocks = (int64_t) 1 << disk->group_shift;
+	disk->num_groups = (num_blocks + group_blocks - 1) >> disk->group_shift;
+	disk->group_free = (int*) malloc(disk->num_groups * sizeof(int));
+	
+	for (int group = 0; group < disk->num_groups; ++group) {
+		int64_t start = (int64_t) group << disk->group_shift;
+		int64_t end = (start + group_blocks < num_blocks) ? start + group_blocks : num_blocks;
+		int occupied = 0;
+		for (int cell = start / NUMBITS; cell < (end + NUMBITS - 1) / NUMBITS; ++cell) {
+			occupied += __builtin_popcount(disk->bitmap_data[cell]);
+		}
+		disk->group_free[group] = (end - start) - occupied;
+	}
+}
+
+// sets the bit of block_num in the bitmap to status,
+// keeping the free blocks counters of the DiskHeader and of the group of the block
+// returns 1 if the bit changed, 0 if it had already that status
+static int AUX_block_set(DiskDriver* disk, int block_num, int status) {
+	if (BitMap_isBitSet(&disk->bmap, block_num) == (status == OCCUPIED)) return 0;
+	BitMap_set(&disk->bmap, block_num, status);
+	int delta = (status == OCCUPIED) ? -1 : 1;
+	disk->header->free_blocks += delta;
+	disk->group_free[block_num >> disk->group_shift] += delta;
+	return 1;
+}
+
 // opens the file (creating it if necessary_
 // allocates the necessary space on the disk
 // calculates how big the bitmap should be
 // if the file was new
 // compiles a disk header, and fills in the bitmap of appropriate size
 // with all 0 (to denote the free space);
-void DiskDriver_init(DiskDriver* disk, const char* filename, int num_blocks) {
+// A file made with another DISK_VERSION is treated as a new one
+// New disks have blocks of BLOCK_SIZE_DEFAULT bytes. A disk has at most DISK_MAX_BLOCKS blocks
+void DiskDriver_init(DiskDriver* disk, const char* filename, int64_t num_blocks) {
+	DiskDriver_initSize(disk, filename, num_blocks, BLOCK_SIZE_DEFAULT);
+}
+
+// same as DiskDriver_init, but a new disk has blocks of block_size bytes.
+// An already existing disk keeps the block size stored in its header
+void DiskDriver_initSize(DiskDriver* disk, const char* filename, int64_t num_blocks, int block_size) {
 	
 	int fok, fd;
 	
+	if (num_blocks <= 0 || num_blocks > DISK_MAX_BLOCKS) {
+		printf ("ERROR : %lld BLOCKS ARE NOT FROM 1 TO %lld\n CLOSING . . .\n", (long long) num_blocks, (long long) DISK_MAX_BLOCKS);
+		exit(EXIT_FAILURE);
+	}
+	if (AUX_block_shift(block_size) == ERROR_FILE_FAULT) {
+		printf ("ERROR : BLOCK SIZE %d IS NOT A POWER OF TWO FROM %d TO %d\n CLOSING . . .\n", block_size, BLOCK_SIZE_MIN, BLOCK_SIZE_MAX);
+		exit(EXIT_FAILURE);
+	}
+	
 	// Testing if the file exists (0) or not (-1)
 	fok = access(filename, F_OK);
 	if (fok == 0) printf ("FILE ALREADY EXISTS : RECOVERING INFORMATIONS\n");
@@ -23,28 +93,42 @@ void DiskDriver_init(DiskDriver* disk, const char* filename, int num_blocks) {
 		exit(EXIT_FAILURE);
 	}
 	
+	// The geometry of an existing disk is in its header, that has to be read before mapping it.
+	// A disk made with another revision of the format can't be read: starting from scratch
+	if (fok == 0) {
+		DiskHeader old_header;
+		if (pread(fd, &old_header, sizeof(DiskHeader), 0) != sizeof(DiskHeader) || old_header.version != DISK_VERSION) {
+			printf ("DISK FORMAT VERSION IS NOT %d : NEED TO CREATE A NEW ONE\n", DISK_VERSION);
+			fok = ERROR_FILE_FAULT;
+		}
+		else if (AUX_block_shift(old_header.block_size) == ERROR_FILE_FAULT) {
+			printf ("DISK BLOCK SIZE %d IS NOT VALID : NEED TO CREATE A NEW ONE\n", old_header.block_size);
+			fok = ERROR_FILE_FAULT;
+		}
+		else block_size = old_header.block_size;
+	}
+	
 	// Calculating dimensions for the map. I need space for:
 	// the header -> sizeof(DiskHeader)
 	// the bitmap entries array -> num_blocks/NUMBITS+1		NUMBITS = 8 , +1 to avoid to lost informations
-	// blocks -> num_blocks * BLOCK_SIZE					BLOCK_SIZE = 512
+	// blocks -> num_blocks * block_size, aligned to block_size
 	size_t header_dim	= sizeof(DiskHeader);
 	size_t entries_dim	= num_blocks / NUMBITS + 1;
-	size_t blocklist_dim = num_blocks * BLOCK_SIZE;
-	size_t map_dim = header_dim + entries_dim + blocklist_dim;
+	size_t map_dim = AUX_map_dim(num_blocks, block_size);
 	
 	// "You are creating a new zero sized file, you can't extend the file size with mmap. 
 	// You'll get a BUS ERROR when you try to write outside the content of the file."
 	// cit. stackoverflow
 	// To avoid this I write the file bringing it to my wanted size.
-	// I do this only if 
-	if (fok != 0) {
-		int voyager = lseek(fd, map_dim, SEEK_SET);
-		if (voyager == ERROR_FILE_FAULT) {
+	// I do this only if the file is shorter than the map (new, or made with a smaller geometry)
+	struct stat snorlax;
+	if (fstat(fd, &snorlax) == ERROR_FILE_FAULT || (size_t) snorlax.st_size <= map_dim) {
+		off_t voyager = lseek(fd, (off_t) map_dim, SEEK_SET);
+		if (voyager == (off_t) ERROR_FILE_FAULT || write(fd, "\0", 1) != 1) {
 			printf ("ERROR : CANNOT PLACE POINTER\n CLOSING . . .\n");
 			close(fd);
 			exit(EXIT_FAILURE);
 		}
-		voyager = write(fd, "\0", 1);
 	}
 	
 	// Mapping the space I need. Choosing this attributes:
@@ -52,12 +136,36 @@ void DiskDriver_init(DiskDriver* disk, const char* filename, int num_blocks) {
 	// PROT_READ | PROT_WRITE : operations to do with the file. Don't need to execute
 	// MAP_SHARED : not private because if so, I could not modify the "disk" with "persistance"
 	void* mapped_mem = mmap(NULL, map_dim, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mapped_mem == ERROR_MAP_FAILED) {
+		printf ("ERROR : CANNOT MAP THE FILE %s\n CLOSING . . .\n", filename);
+		close(fd);
+		exit(EXIT_FAILURE);
+	}
 	
 	
 	// Starting to set up my Disk Driver
 	disk->header = (DiskHeader*) mapped_mem;
 	disk->bitmap_data = (uint8_t*) (mapped_mem + header_dim);
+	disk->blocks = (uint8_t*) (mapped_mem + AUX_blocklist_start(num_blocks, block_size));
 	disk->fd = fd;	
+	disk->block_size = block_size;
+	disk->block_shift = AUX_block_shift(block_size);
+	disk->header->version = DISK_VERSION;
+	disk->header->block_size = block_size;
+	disk->header->group_blocks = GROUP_BLOCKS(block_size);
+	disk->group_shift = __builtin_ctz(GROUP_BLOCKS(block_size));
+	
+	// The counters can be trusted only if the disk was unmapped correctly
+	// and it's mounted with the same geometry
+	int trusted = 0;
+	if (fok == 0) {
+		trusted = disk->header->clean == DISK_CLEAN &&
+			disk->header->num_blocks == num_blocks &&
+			disk->header->bitmap_entries == entries_dim &&
+			disk->header->checksum == DiskDriver_checksum(disk->header);
+		if (!trusted) printf ("DISK WAS NOT UNMAPPED CORRECTLY : COUNTING FREE BLOCKS\n");
+	}
+	
 	disk->header->num_blocks = num_blocks;
 	disk->header->bitmap_blocks = num_blocks;
 	disk->header->bitmap_entries = entries_dim;
@@ -65,22 +173,37 @@ void DiskDriver_init(DiskDriver* disk, const char* filename, int num_blocks) {
 	// IF the file was already existent I just need to do operations on free blocks
 	// ELSE I need to set the entire bitmap on zero
 	
-	BitMap bmap;
-	bmap.num_bits = entries_dim;
-	bmap.entries = disk->bitmap_data;
-	int free_blocks = BitMap_getFreeBlocks(&bmap);
+	disk->pinned_blocks = 0;
+	disk->bmap.num_bits = entries_dim;
+	disk->bmap.entries = disk->bitmap_data;
+	disk->bmap.summary = NULL;
 		
 	if (fok == 0) {
-		disk->header->free_blocks = free_blocks - (entries_dim * NUMBITS - num_blocks);
-		disk->header->first_free_block = BitMap_get(&bmap, 0, FREE);		
+		if (!trusted) {
+			int64_t free_blocks = BitMap_getFreeBlocks(&disk->bmap);
+			disk->header->free_blocks = free_blocks - (entries_dim * NUMBITS - num_blocks);
+			disk->header->first_free_block = BitMap_get(&disk->bmap, 0, FREE);
+		}
 	}
 	else {
 		for (int i = 0; i < entries_dim; ++i) {
 			(disk->bitmap_data)[i] = 0;
 		}
-		disk->header->free_blocks = free_blocks - (free_blocks -num_blocks);
+		disk->header->free_blocks = num_blocks;
 		disk->header->first_free_block = 0;
 	}
+	BitMap_buildSummary(&disk->bmap);
+	AUX_groups_count(disk);
+	
+	// From now on the disk is in use: if we crash the counters must be recounted.
+	// Flushing the header so that the dirty mark hits the disk before any other change
+	disk->header->clean = DISK_DIRTY;
+	msync(disk->header, header_dim, MS_SYNC);
+}
+
+// returns the address of the block in position block_num inside the map
+static inline void* AUX_block_address(DiskDriver* disk, int block_num) {
+	return disk->blocks + ((off_t) block_num << disk->block_shift);
 }
 
 // reads the block in position block_num
@@ -88,18 +211,11 @@ void DiskDriver_init(DiskDriver* disk, const char* filename, int num_blocks) {
 // 0 otherwise
 int DiskDriver_readBlock(DiskDriver* disk, void* dest, int block_num) {
 	
-	// Calculating the offset where the blocklist starts (in the map)
-	off_t blocklist_start = (off_t) sizeof(DiskHeader) + disk->header->bitmap_entries;
-
 	// Copying the wanted block in dest
-	void* map_block = (void*) disk->header + blocklist_start + block_num * BLOCK_SIZE;
-	memcpy(dest, map_block, BLOCK_SIZE);
-	
-	BitMap bmap;
-	bmap.num_bits = disk->header->num_blocks;
-	bmap.entries = disk->bitmap_data;
+	void* map_block = AUX_block_address(disk, block_num);
+	if (map_block != dest) memcpy(dest, map_block, disk->block_size);
 	
-	int isSet = BitMap_isBitSet(&bmap, block_num);
+	int isSet = BitMap_isBitSet(&disk->bmap, block_num);
 	if (isSet) return 0;
 	else return -1;
 }
@@ -109,83 +225,195 @@ int DiskDriver_readBlock(DiskDriver* disk, void* dest, int block_num) {
 // returns -1 if operation not possible
 int DiskDriver_writeBlock(DiskDriver* disk, void* src, int block_num) {
 	
-	// Calculating the offset where the blocklist starts (in the map)
-	off_t blocklist_start = (off_t) sizeof(DiskHeader) + disk->header->bitmap_entries;
-	
 	// Copying the src in the wanted block
-	void* map_block = (void*) disk->header + blocklist_start + block_num * BLOCK_SIZE;
-	memcpy(map_block, src, BLOCK_SIZE);
+	void* map_block = AUX_block_address(disk, block_num);
+	if (map_block != src) memcpy(map_block, src, disk->block_size);
 
 	// Altering the bitmap and updating the DiskHeader
 	// If we are overwriting the block do not alter the bitmap
-	BitMap bmap;
-	bmap.num_bits = disk->header->bitmap_blocks;
-	bmap.entries = disk->bitmap_data;
-	if (BitMap_isBitSet(&bmap, block_num)) {
-		disk->header->first_free_block = BitMap_get(&bmap, 0, FREE);
+	BitMap* bmap = &disk->bmap;
+	if (BitMap_isBitSet(bmap, block_num)) {
+		disk->header->first_free_block = BitMap_get(bmap, 0, FREE);
 		return 0;
 	}
 	
-	int set = BitMap_set(&bmap, block_num, OCCUPIED);
-	if (set == ERROR_RESEARCH_FAULT) {
+	if (block_num < 0 || block_num >= disk->header->num_blocks) {
 		printf ("ERROR : CANNOT LOOK FOR THE WANTED BIT DURING WRITING\n CLOSING . . .\n");
 		return ERROR_FILE_FAULT;
 	}
 	
-	--(disk->header->free_blocks);
-	disk->header->first_free_block = BitMap_get(&bmap, 0, FREE);
+	AUX_block_set(disk, block_num, OCCUPIED);
+	disk->header->first_free_block = BitMap_get(bmap, 0, FREE);
+	
+	
+	return disk->block_size;
+}
+
+// returns a pointer to the block in position block_num inside the map,
+// so that it can be read or modified in place without copying it.
+// mode == BLOCK_READ : returns NULL if the block is free according to the bitmap
+// mode == BLOCK_WRITE : marks the block as occupied, as DiskDriver_writeBlock does
+// every pointer has to be given back with DiskDriver_releaseBlock
+void* DiskDriver_getBlockPtr(DiskDriver* disk, int block_num, int mode) {
+	if (block_num < 0 || block_num >= disk->header->num_blocks) return NULL;
+	BitMap* bmap = &disk->bmap;
+	
+	if (!BitMap_isBitSet(bmap, block_num)) {
+		if (mode == BLOCK_READ) return NULL;
+		
+		// Writing a free block: altering the bitmap and updating the DiskHeader
+		AUX_block_set(disk, block_num, OCCUPIED);
+		disk->header->first_free_block = BitMap_get(bmap, 0, FREE);
+	}
+	
+	++(disk->pinned_blocks);
+	return AUX_block_address(disk, block_num);
+}
+
+// returns a pointer to the len contiguous blocks from block_num on inside the map,
+// as DiskDriver_getBlockPtr does for a single one, so that a run of blocks is copied at once.
+// mode == BLOCK_READ : returns NULL if any of them is free according to the bitmap
+// mode == BLOCK_WRITE : marks them as occupied
+// the pointer has to be given back with DiskDriver_releaseBlock
+void* DiskDriver_getExtentPtr(DiskDriver* disk, int block_num, int len, int mode) {
+	if (block_num < 0 || len <= 0 || (int64_t) block_num + len > disk->header->num_blocks) return NULL;
+	BitMap* bmap = &disk->bmap;
 	
+	int changed = 0;
+	for (int block = block_num; block < block_num + len; ++block) {
+		if (BitMap_isBitSet(bmap, block)) continue;
+		if (mode == BLOCK_READ) return NULL;
+		
+		// Writing a free block: altering the bitmap and updating the DiskHeader
+		AUX_block_set(disk, block, OCCUPIED);
+		changed = 1;
+	}
+	if (changed) disk->header->first_free_block = BitMap_get(bmap, 0, FREE);
 	
-	return BLOCK_SIZE;
+	++(disk->pinned_blocks);
+	return AUX_block_address(disk, block_num);
+}
+
+// releases a pointer given by DiskDriver_getBlockPtr
+// returns -1 if there are no pinned blocks, 0 otherwise
+int DiskDriver_releaseBlock(DiskDriver* disk, void* block) {
+	if (block == NULL) return 0;
+	if (disk->pinned_blocks <= 0) {
+		printf ("ERROR : RELEASING A BLOCK THAT WAS NOT PINNED\n");
+		return ERROR_FILE_FAULT;
+	}
+	--(disk->pinned_blocks);
+	return 0;
 }
 
 // frees a block in position block_num, and alters the bitmap accordingly
 // don't need to write all zeroes in the memory: just change the bitmap.
 // returns -1 if operation not possible, 0 if success
 int DiskDriver_freeBlock(DiskDriver* disk, int block_num) {
-	BitMap bmap;
-	bmap.num_bits = disk->header->bitmap_blocks;
-	bmap.entries = disk->bitmap_data;
+	BitMap* bmap = &disk->bmap;
 	// If we are freeing a block that was already free do not alter the bitmap
-	if (!BitMap_isBitSet(&bmap, block_num)) {
-		disk->header->first_free_block = BitMap_get(&bmap, 0, FREE);
+	if (!BitMap_isBitSet(bmap, block_num)) {
+		disk->header->first_free_block = BitMap_get(bmap, 0, FREE);
 		return 0;
 	}
 	
-	int set = BitMap_set(&bmap, block_num, FREE);
-	if (set == ERROR_RESEARCH_FAULT) {
+	if (block_num < 0 || block_num >= disk->header->num_blocks) {
 		return ERROR_RESEARCH_FAULT;
 	}
 	
 	// Updating the DiskHeader
-	++(disk->header->free_blocks);
-	disk->header->first_free_block = BitMap_get(&bmap, 0, FREE);
+	AUX_block_set(disk, block_num, FREE);
+	disk->header->first_free_block = BitMap_get(bmap, 0, FREE);
 	
-	return set;
+	return 0;
 }
 
 // returns the first free blockin the disk from position (checking the bitmap)
+// returns -1 if the disk is full
 int DiskDriver_getFreeBlock(DiskDriver* disk, int start) {
-	BitMap bmap;
-	bmap.num_bits = disk->header->bitmap_blocks;
-	bmap.entries = disk->bitmap_data;
-	return BitMap_get(&bmap, start, FREE);
+	int block = BitMap_get(&disk->bmap, start, FREE);
+	
+	// The last bitmap cell can have bits after the last block
+	if (block >= disk->header->num_blocks) return ERROR_FILE_FAULT;
+	return block;
+}
+
+// looks for a run of at least min_len free blocks in [from, to)
+// returns the first block of the run, -1 if there is none
+static int AUX_find_extent(DiskDriver* disk, int from, int to, int min_len) {
+	int start = BitMap_getRun(&disk->bmap, from, min_len);
+	if (start == ERROR_RESEARCH_FAULT || start + min_len > to) return ERROR_FILE_FAULT;
+	return start;
+}
+
+// allocates a run of at least min_len and at most max_len contiguous free blocks,
+// looking from block hint to the end of the disk and then from the beginning.
+// The blocks are marked as occupied in the bitmap, their content is not touched.
+// returns the first block of the run and stores its length in len (if not NULL)
+// returns -1 if there is no run long enough
+int DiskDriver_allocExtent(DiskDriver* disk, int hint, int min_len, int max_len, int* len) {
+	int num_blocks = disk->header->num_blocks;
+	if (min_len <= 0 || max_len < min_len || min_len > disk->header->free_blocks) return ERROR_FILE_FAULT;
+	if (hint < 0 || hint >= num_blocks) hint = 0;
+	
+	// First fit from the hint, then wrapping around
+	int start = AUX_find_extent(disk, hint, num_blocks, min_len);
+	if (start == ERROR_FILE_FAULT && hint > 0) {
+		start = AUX_find_extent(disk, 0, hint + min_len - 1, min_len);
+	}
+	if (start == ERROR_FILE_FAULT) return ERROR_FILE_FAULT;
+	
+	// The run goes on until the first occupied block, the end of the disk or max_len
+	int end = BitMap_getBit(&disk->bmap, start, OCCUPIED);
+	if (end == ERROR_RESEARCH_FAULT || end > num_blocks) end = num_blocks;
+	if (end - start > max_len) end = start + max_len;
+	
+	// Updating the DiskHeader
+	for (int block = start; block < end; ++block) {
+		AUX_block_set(disk, block, OCCUPIED);
+	}
+	disk->header->first_free_block = BitMap_get(&disk->bmap, 0, FREE);
+	
+	if (len != NULL) *len = end - start;
+	return start;
+}
+
+// frees len contiguous blocks starting from block start
+// returns -1 if operation not possible, 0 if success
+int DiskDriver_freeExtent(DiskDriver* disk, int start, int len) {
+	if (start < 0 || len < 0 || start + len > disk->header->num_blocks) return ERROR_FILE_FAULT;
+	
+	// Only the blocks that were occupied change the counters
+	for (int block = start; block < start + len; ++block) {
+		AUX_block_set(disk, block, FREE);
+	}
+	disk->header->first_free_block = BitMap_get(&disk->bmap, 0, FREE);
+	return 0;
+}
+
+// returns the allocation group of the block block_num
+int DiskDriver_group(DiskDriver* disk, int block_num) {
+	return block_num >> disk->group_shift;
+}
+
+// returns the first block of the allocation group group
+int DiskDriver_groupStart(DiskDriver* disk, int group) {
+	return group << disk->group_shift;
+}
+
+// returns the free blocks of the allocation group group, -1 if it does not exist
+int DiskDriver_groupFree(DiskDriver* disk, int group) {
+	if (group < 0 || group >= disk->num_groups) return ERROR_FILE_FAULT;
+	return disk->group_free[group];
 }
 
 // writes the data (flushing the mmaps)
 int DiskDriver_flush(DiskDriver* disk) {
 	
-	int num_blocks = disk->header->num_blocks;
 	int voyager;
 	
-	// Calculating map dimensions
-	size_t header_dim = sizeof(DiskHeader);
-	size_t entries_dim = num_blocks / NUMBITS;
-	size_t blocklist_dim = num_blocks * BLOCK_SIZE;
-	size_t map_dim = header_dim + entries_dim + blocklist_dim;
-	
 	// Flushing the map
-	voyager = msync(disk->header, map_dim, MS_SYNC);
+	voyager = msync(disk->header, AUX_map_dim(disk->header->num_blocks, disk->block_size), MS_SYNC);
 	if (voyager != 0) {
 		printf ("ERROR : CANNOT FLUSH THE MAP\n CLOSING . . .\n");
 		exit(EXIT_FAILURE);
@@ -194,12 +422,36 @@ int DiskDriver_flush(DiskDriver* disk) {
 	return voyager;
 }
 
+// computes the checksum of the free blocks counters stored in the header
+// (FNV-1a on the counters, so that a stale or half written header is not trusted)
+uint32_t DiskDriver_checksum(DiskHeader* header) {
+	int64_t fields[] = {
+		header->version,
+		header->num_blocks,
+		header->bitmap_blocks,
+		header->bitmap_entries,
+		header->free_blocks,
+		header->first_free_block,
+		header->block_size,
+		header->group_blocks
+	};
+	uint32_t hash = 2166136261u;
+	uint8_t* bytes = (uint8_t*) fields;
+	for (int i = 0; i < sizeof(fields); ++i) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 // Unmap the map
+// marks the disk as clean so that the next mount can skip counting free blocks
 int DiskDriver_unmap(DiskDriver* disk) {
-	int num_blocks = disk->header->bitmap_blocks;
-	size_t header_dim	= sizeof(DiskHeader);
-	size_t entries_dim	= num_blocks / NUMBITS;
-	size_t blocklist_dim = num_blocks * BLOCK_SIZE;
-	size_t map_dim = header_dim + entries_dim + blocklist_dim;
-	return munmap((void*)disk->header, map_dim);
+	BitMap_freeSummary(&disk->bmap);
+	free(disk->group_free);
+	disk->group_free = NULL;
+	disk->header->checksum = DiskDriver_checksum(disk->header);
+	disk->header->clean = DISK_CLEAN;
+	
+	return munmap((void*)disk->header, AUX_map_dim(disk->header->num_blocks, disk->block_size));
 }
@@ -14,27 +14,77 @@
 // For access()
 #include <unistd.h>
 
-// Size of a block
-#define BLOCK_SIZE 512
+// For INT_MAX
+#include <limits.h>
+
+// Size of a block. It's chosen when the disk is created and stored in the DiskHeader:
+// a power of two from BLOCK_SIZE_MIN to BLOCK_SIZE_MAX
+#define BLOCK_SIZE_MIN		512
+#define BLOCK_SIZE_MAX		65536
+#define BLOCK_SIZE_DEFAULT	512
+
+// Largest disk: the blocks are numbered with an int, and so are the bits of the bitmap
+// (one more cell than needed, so the last block number plus a cell has to fit too)
+#define DISK_MAX_BLOCKS		((int64_t) INT_MAX - NUMBITS)
+
+// Allocation groups: the disk is divided in groups of as many blocks as the bits of a block of the bitmap.
+// Each group has its slice of the bitmap and its free blocks counter, so that related blocks can be kept together
+#define GROUP_BLOCKS(block_size)	((block_size) * NUMBITS)
 
 // Possible ERRORS that can occurr
 #define ERROR_FILE_FAULT -1
 #define ERROR_MAP_FAILED	(void*) -1
 
+// Access modes of a pinned block
+#define BLOCK_READ	0
+#define BLOCK_WRITE	1
+
+// Mount state of the disk, stored in the DiskHeader
+#define DISK_DIRTY	0		// mounted, or not unmapped correctly
+#define DISK_CLEAN	1		// unmapped correctly: the free blocks counters can be trusted
+
+// Revision of the on-disk format, stored in the DiskHeader.
+// An image with a different revision is not mounted: it's created again
+// 1 : 32 bits counters and sizes
+// 2 : 64 bits counters in the DiskHeader and 64 bits sizes in the iNodes
+// 3 : block size in the DiskHeader, blocks aligned to the block size in the file
+// 4 : data blocks of the files have no header
+// 5 : files mapped by extents instead of lists of blocks
+// 6 : small files stored inline in their iNode
+// 7 : iNodes packed in a table of their own, with a bitmap
+// 8 : disk divided in allocation groups
+// 9 : valid length of the files in their iNodes, for the preallocated blocks
+#define DISK_VERSION	9
+
 // this is stored in the 1st block of the disk
 typedef struct {
-	int num_blocks;		 // number of blocks used for files and directories
-	int bitmap_blocks;   // how many blocks in the bitmap
-	int bitmap_entries;  // how many bytes are needed to store the bitmap
-
-	int free_blocks;     // free blocks
-	int first_free_block;// first block index
+	uint32_t version;    // DISK_VERSION of the format the disk was created with
+	int clean;           // DISK_CLEAN if the disk was unmapped correctly, DISK_DIRTY otherwise
+
+	int64_t num_blocks;		 // number of blocks used for files and directories
+	int64_t bitmap_blocks;   // how many blocks in the bitmap
+	int64_t bitmap_entries;  // how many bytes are needed to store the bitmap
+
+	int64_t free_blocks;     // free blocks
+	int64_t first_free_block;// first block index
+	
+	int block_size;      // size of a block, in bytes
+	int group_blocks;    // blocks in an allocation group (the last one can have less)
+	uint32_t checksum;   // checksum of the version and of the counters above, written at unmap time
 } DiskHeader; 
 
 typedef struct {
 	DiskHeader* header; // mmapped
 	uint8_t* bitmap_data;  // mmapped (bitmap array of entries)
 	int fd; // for us
+	BitMap bmap;	// bitmap on bitmap_data, with its summary (in memory, rebuilt at init)
+	int pinned_blocks;	// block pointers given by DiskDriver_getBlockPtr and not released yet
+	uint8_t* blocks;	// mmapped (first block)
+	int block_size;		// repeated from the header
+	int block_shift;	// log2 of block_size
+	int group_shift;	// log2 of group_blocks
+	int num_groups;		// allocation groups
+	int* group_free;	// free blocks of each group (in memory, counted at init)
 } DiskDriver;
 
 /**
@@ -48,7 +98,16 @@ typedef struct {
 // if the file was new
 // compiles a disk header, and fills in the bitmap of appropriate size
 // with all 0 (to denote the free space);
-void DiskDriver_init(DiskDriver* disk, const char* filename, int num_blocks);
+// if the file already existed and was unmapped correctly the free blocks counters
+// in the header are trusted, else they're recounted from the bitmap.
+// A file made with another DISK_VERSION is treated as a new one.
+// The summary of the bitmap is built from scratch, and so are the free blocks counters of the groups
+// New disks have blocks of BLOCK_SIZE_DEFAULT bytes. A disk has at most DISK_MAX_BLOCKS blocks
+void DiskDriver_init(DiskDriver* disk, const char* filename, int64_t num_blocks);
+
+// same as DiskDriver_init, but a new disk has blocks of block_size bytes.
+// An already existing disk keeps the block size stored in its header
+void DiskDriver_initSize(DiskDriver* disk, const char* filename, int64_t num_blocks, int block_size);
 
 // reads the block in position block_num
 // returns -1 if the block is free accrding to the bitmap
@@ -59,17 +118,61 @@ int DiskDriver_readBlock(DiskDriver* disk, void* dest, int block_num);
 // returns -1 if operation not possible
 int DiskDriver_writeBlock(DiskDriver* disk, void* src, int block_num);
 
+// returns a pointer to the block in position block_num inside the map,
+// so that it can be read or modified in place without copying it.
+// mode == BLOCK_READ : returns NULL if the block is free according to the bitmap
+// mode == BLOCK_WRITE : marks the block as occupied, as DiskDriver_writeBlock does
+// every pointer has to be given back with DiskDriver_releaseBlock
+void* DiskDriver_getBlockPtr(DiskDriver* disk, int block_num, int mode);
+
+// returns a pointer to the len contiguous blocks from block_num on inside the map,
+// as DiskDriver_getBlockPtr does for a single one, so that a run of blocks is copied at once.
+// mode == BLOCK_READ : returns NULL if any of them is free according to the bitmap
+// mode == BLOCK_WRITE : marks them as occupied
+// the pointer has to be given back with DiskDriver_releaseBlock
+void* DiskDriver_getExtentPtr(DiskDriver* disk, int block_num, int len, int mode);
+
+// releases a pointer given by DiskDriver_getBlockPtr
+// returns -1 if there are no pinned blocks, 0 otherwise
+int DiskDriver_releaseBlock(DiskDriver* disk, void* block);
+
 // frees a block in position block_num, and alters the bitmap accordingly
 // returns -1 if operation not possible
 int DiskDriver_freeBlock(DiskDriver* disk, int block_num);
 
 // returns the first free blockin the disk from position (checking the bitmap)
+// returns -1 if the disk is full
 int DiskDriver_getFreeBlock(DiskDriver* disk, int start);
 
+// allocates a run of at least min_len and at most max_len contiguous free blocks,
+// looking from block hint to the end of the disk and then from the beginning.
+// The blocks are marked as occupied in the bitmap, their content is not touched.
+// returns the first block of the run and stores its length in len (if not NULL)
+// returns -1 if there is no run long enough
+int DiskDriver_allocExtent(DiskDriver* disk, int hint, int min_len, int max_len, int* len);
+
+// frees len contiguous blocks starting from block start
+// returns -1 if operation not possible, 0 if success
+int DiskDriver_freeExtent(DiskDriver* disk, int start, int len);
+
+// returns the allocation group of the block block_num
+int DiskDriver_group(DiskDriver* disk, int block_num);
+
+// returns the first block of the allocation group group
+int DiskDriver_groupStart(DiskDriver* disk, int group);
+
+// returns the free blocks of the allocation group group, -1 if it does not exist
+int DiskDriver_groupFree(DiskDriver* disk, int group);
+
 // writes the data (flushing the mmaps)
 int DiskDriver_flush(DiskDriver* disk);
 
+// computes the checksum of the free blocks counters stored in the header
+uint32_t DiskDriver_checksum(DiskHeader* header);
+
 // Unmap the map
+// marks the disk as clean so that the next mount can skip counting free blocks
+// and destroys the summary of the bitmap and the counters of the groups
 int DiskDriver_unmap(DiskDriver* disk);
 
 /*	NOTES
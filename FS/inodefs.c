@@ -4,20 +4,25 @@
 // returns a handle to the top level directory stored in the first block
 DirectoryHandle* iNodeFS_init(iNodeFS* fs, DiskDriver* disk) {
 	fs->disk = disk;
+	AUX_dcache_init(&fs->dcache);
+	AUX_icache_init(&fs->icache);
+	AUX_pool_init(&fs->pool);
+	
+	// If operating on a new disk return NULL: we need to format it
+	if (AUX_itable_mount(fs) == TBA) return NULL;
+	iNode* firstdir = AUX_iget(fs, 0);
+	if (firstdir == NULL) {
+		AUX_icache_free(&fs->icache);
+		return NULL;
+	}
 	
 	// creating the directory handle and filling it
 	DirectoryHandle* handle = (DirectoryHandle*) malloc(sizeof(DirectoryHandle));
-	iNode* firstdir = (iNode*) malloc(sizeof(iNode));
-	
-	// If operating on a new disk return NULL: we need to format it
-	int snorlax = DiskDriver_readBlock(disk, firstdir, 0);
-	if (snorlax) return NULL;
 	
 	// Filling the handle
 	handle->infs = fs;
 	handle->dcb = firstdir;
 	handle->directory = NULL;
-	handle->indirect = NULL;
 	handle->current_block = &firstdir->header;
 	handle->pos_in_node = 0;
 	handle->pos_in_block = 0;
@@ -30,17 +35,57 @@ DirectoryHandle* iNodeFS_init(iNodeFS* fs, DiskDriver* disk) {
 // it also clears the bitmap of occupied blocks on the disk
 // the current_directory_block is cached in the iNodeFS struct
 // and set to the top level directory
+// the iNode table has an iNode for every INODE_RATIO blocks
 void iNodeFS_format(iNodeFS* fs) {
-	int num_blocks = fs->disk->header->num_blocks;
+	iNodeFS_formatInodes(fs, fs->disk->header->num_blocks / INODE_RATIO);
+}
+
+// same as iNodeFS_format, with an iNode table of (at least) num_inodes iNodes
+void iNodeFS_formatInodes(iNodeFS* fs, int num_inodes) {
+	DiskDriver* disk = fs->disk;
+	int num_blocks = disk->header->num_blocks;
+	
+	// The layout: the SuperBlock, the bitmap of the iNodes and the table.
+	// The last block of the table is filled with iNodes too.
+	// It's checked before freeing anything, so that a bad one leaves the disk as it was
+	int per_block = disk->block_size / INODE_SIZE;
+	int bits_per_block = disk->block_size * NUMBITS;
+	if (num_inodes < 1) num_inodes = 1;
+	int table_blocks = (num_inodes + per_block - 1) / per_block;
+	num_inodes = table_blocks * per_block;
+	int bitmap_blocks = (num_inodes + bits_per_block - 1) / bits_per_block;
+	int data_start = 1 + bitmap_blocks + table_blocks;
+	if (data_start >= num_blocks) {
+		printf ("ERROR TOO MANY INODES FOR THE DISK @ iNodeFS_formatInodes()\n");
+		return;
+	}
+	AUX_dcache_init(&fs->dcache);
 	for (int i = 0; i < num_blocks; ++i) {
-		DiskDriver_freeBlock(fs->disk, i);
+		DiskDriver_freeBlock(disk, i);
 	}
 	
+	// Writing them all at once, cleared
+	char* aux_fb = (char*) DiskDriver_getExtentPtr(disk, 0, data_start, BLOCK_WRITE);
+	memset(aux_fb, 0, (size_t) data_start * disk->block_size);
+	SuperBlock* super = (SuperBlock*) aux_fb;
+	super->inode_size = INODE_SIZE;
+	super->num_inodes = num_inodes;
+	super->free_inodes = num_inodes;
+	super->bitmap_start = 1;
+	super->bitmap_blocks = bitmap_blocks;
+	super->table_start = 1 + bitmap_blocks;
+	super->table_blocks = table_blocks;
+	super->data_start = data_start;
+	super->inodes_per_group = (num_inodes + disk->num_groups - 1) / disk->num_groups;
+	DiskDriver_releaseBlock(disk, aux_fb);
+	AUX_itable_mount(fs);
+	
 	// Once the disk is free, creating the directory header
+	// The top level directory is the first iNode
 	BlockHeader header;
 	header.block_in_file = TBA;
 	header.block_in_node = TBA;
-	header.block_in_disk = 0;
+	header.block_in_disk = AUX_inode_alloc(fs, 0);
 	
 	// Creating the ICB
 	iNodeControlBlock icb;
@@ -51,908 +96,993 @@ void iNodeFS_format(iNodeFS* fs) {
 	
 	// Creating the FCB
 	FileControlBlock fcb;
-	fcb.size_in_bytes = BLOCK_SIZE;
-	fcb.size_in_blocks = 1;
+	memset(&fcb, 0, sizeof(FileControlBlock));
+	fcb.size_in_bytes = 0;
+	fcb.size_in_blocks = 0;
 	fcb.icb = icb;
-	strcpy(fcb.name, "/");
 	
-	// Creating the First Directory Block
-	iNode firstdir;
-	firstdir.header = header;
-	firstdir.fcb = fcb;
-	firstdir.num_entries = 0;
-	firstdir.single_indirect = TBA;
-	firstdir.double_indirect = TBA;
-	int size = (BLOCK_SIZE - sizeof(BlockHeader) - sizeof(FileControlBlock) - sizeof(int) - sizeof(int) - sizeof(int)) / sizeof(int);
-	for (int i = 0; i < size; ++i) {
-		firstdir.file_blocks[i] = TBA;
-	}
+	// Creating the First Directory Block. Not from the scratch pool: iNodeFS_init empties it
+	iNode* firstdir = (iNode*) calloc(1, INODE_SIZE);
+	firstdir->header = header;
+	firstdir->fcb = fcb;
+	firstdir->num_entries = 0;
+	firstdir->depth = 0;
+	firstdir->num_extents = 0;
+	firstdir->index_buckets = 0;
 	
 	// Writing all the content on the disk
-	DiskDriver_writeBlock(fs->disk, &firstdir, 0);
+	AUX_inode_write(fs, firstdir);
+	free (firstdir);
 	
 }
 
-// Duplicates a directory handle
-DirectoryHandle* AUX_duplicate_dirhandle(DirectoryHandle* d) {
-	DirectoryHandle* daux = (DirectoryHandle*) malloc(sizeof(DirectoryHandle));
-	daux->infs = d->infs;
-	daux->dcb = d->dcb;
-	daux->directory = d->directory;
-	daux->indirect = d->indirect;
-	daux->current_block = d->current_block;
-	daux->pos_in_node = d->pos_in_node;
-	daux->pos_in_block = d->pos_in_block;
+// reads the SuperBlock of the disk of fs and sets the iNode table of fs on it
+// returns 0 on success, -1 if the disk is not formatted
+int AUX_itable_mount(iNodeFS* fs) {
+	
+	// The SuperBlock and the bitmap are used in place for as long as the disk is mapped,
+	// so they're not kept pinned
+	SuperBlock* super = (SuperBlock*) DiskDriver_getBlockPtr(fs->disk, 0, BLOCK_READ);
+	if (super == NULL) return TBA;
+	DiskDriver_releaseBlock(fs->disk, super);
+	if (super->inode_size != INODE_SIZE || super->data_start >= fs->disk->header->num_blocks) {
+		printf ("ERROR BAD SUPERBLOCK @ AUX_itable_mount()\n");
+		return TBA;
+	}
+	
+	uint8_t* entries = (uint8_t*) DiskDriver_getExtentPtr(fs->disk, super->bitmap_start, super->bitmap_blocks, BLOCK_READ);
+	if (entries == NULL) return TBA;
+	DiskDriver_releaseBlock(fs->disk, entries);
 	
-	return daux;
+	fs->super = super;
+	fs->ibmap.num_bits = (super->num_inodes + NUMBITS - 1) / NUMBITS;
+	fs->ibmap.entries = entries;
+	fs->ibmap.summary = NULL;
+	
+	return 0;
 }
 
-// Duplicates a file handle
-FileHandle* AUX_duplicate_filehandle(FileHandle* f) {
-	FileHandle* faux = (FileHandle*) malloc(sizeof(FileHandle));
-	faux->infs = f->infs;
-	faux->fcb = f->fcb;
-	faux->directory = f->directory;
-	faux->indirect = f->indirect;
-	faux->current_block = f->current_block;
-	faux->pos_in_node = f->pos_in_node;
-	faux->pos_in_block = f->pos_in_block;
-	
-	return faux;
+// returns the address of the iNode number ino in the table, pinned in the map
+// returns NULL if ino is not in the table
+iNode* AUX_inode_slot(iNodeFS* fs, int ino) {
+	if (ino < 0 || ino >= fs->super->num_inodes) return NULL;
+	int per_block = fs->disk->block_size / INODE_SIZE;
+	char* aux_fb = (char*) DiskDriver_getBlockPtr(fs->disk, fs->super->table_start + ino / per_block, BLOCK_READ);
+	if (aux_fb == NULL) return NULL;
+	return (iNode*) (aux_fb + (ino % per_block) * INODE_SIZE);
+}
+
+// copies the iNode number ino from the table to dest
+// returns 0 on success, -1 if ino is not in use
+int AUX_inode_read(iNodeFS* fs, int ino, iNode* dest) {
+	if (ino < 0 || ino >= fs->super->num_inodes || !BitMap_isBitSet(&fs->ibmap, ino)) return TBA;
+	iNode* slot = AUX_inode_slot(fs, ino);
+	if (slot == NULL) return TBA;
+	memcpy(dest, slot, INODE_SIZE);
+	DiskDriver_releaseBlock(fs->disk, slot);
+	return 0;
 }
 
-// puts the directoryhandle at the right place in the inode with side effect
-// mode == READ or WRITE
-void AUX_indirect_dir_management (DirectoryHandle* d, int mode) {
+// copies node in its slot of the table (the one of its number, in header.block_in_disk)
+// returns 0 on success, -1 on error
+int AUX_inode_write(iNodeFS* fs, iNode* node) {
+	iNode* slot = AUX_inode_slot(fs, node->header.block_in_disk);
+	if (slot == NULL) return TBA;
+	memcpy(slot, node, INODE_SIZE);
+	DiskDriver_releaseBlock(fs->disk, slot);
+	return 0;
+}
+
+// takes a free iNode from the table, the first one from hint on (wrapping around)
+// returns its number, -1 if the table is full
+int AUX_inode_alloc(iNodeFS* fs, int hint) {
+	SuperBlock* super = fs->super;
+	if (super->free_inodes <= 0) return TBA;
+	if (hint < 0 || hint >= super->num_inodes) hint = 0;
+	
+	int voyager = BitMap_getBit(&fs->ibmap, hint, FREE);
+	if (voyager == ERROR_RESEARCH_FAULT || voyager >= super->num_inodes) {
+		voyager = BitMap_getBit(&fs->ibmap, 0, FREE);
+	}
+	if (voyager == ERROR_RESEARCH_FAULT || voyager >= super->num_inodes) return TBA;
 	
-	// Preliminary stuffs
-	if (d == NULL) return;
-	DiskDriver* disk = d->infs->disk;
-	int snorlax = TBA;
-	iNode_indirect* aux_node = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-	
-	// we're in the main node (type DIR), so f->indirect == NULL;
-	// if there's need to create an indirect node, create it, write it and locate the dirhandle
-	if (d->indirect == NULL) {
-		// There's space in DIR
-		if (d->pos_in_node < inode_idx_size) return;
-		// Need to create indirect node
-		if (d->dcb->single_indirect == TBA && mode == WRITE) {
-			
-			int voyager = DiskDriver_getFreeBlock(disk, 0);
-			if (voyager == TBA) {
-				printf ("ERROR DISK FULL @ AUX_indirect_dir_management()\n");
-				return;
-			}
-			
-			// Creating BlockHeader
-			BlockHeader header;
-			header.block_in_file = TBA;
-			header.block_in_node = SINGLE;
-			header.block_in_disk = voyager;
-			
-			// Creating icb
-			iNodeControlBlock icb;
-			if (d->directory != NULL) {
-				icb.directory_block = d->directory->header.block_in_disk;
-			} else icb.directory_block = TBA;
-			icb.block_in_disk = header.block_in_disk;
-			icb.upper = d->dcb->header.block_in_disk;
-			icb.node_type = NOD;
-			
-			// NOD stuffs
-			aux_node->header = header;
-			aux_node->icb = icb;
-			aux_node->num_entries = 0;
-			for (int i = 0; i < indirect_idx_size; ++i) {
-				aux_node->file_blocks[i] = TBA;
-			}
-						
-			// Writing on the disk
-			snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-			if (snorlax == TBA) {
-				printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-				
-				// Freeing memory
-				aux_node = NULL;
-				free (aux_node);
-				return;
-			}
-			// Updating d->dcb
-			d->dcb->single_indirect = aux_node->header.block_in_disk;
-			d->dcb->fcb.size_in_blocks += 1;
-			d->dcb->fcb.size_in_bytes += BLOCK_SIZE;
-			snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-			if (snorlax == TBA) {
-				printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-				
-				// Freeing memory
-				aux_node = NULL;
-				free (aux_node);
-				return;
-			}
-			
-			// Updating d
-			d->indirect = aux_node;
-			d->current_block = &(aux_node->header);
-			d->pos_in_node = 0;
-			d->pos_in_block = 0;
-			
-		}
-		// Don't need to create indiecto node : it already exists
-		// just update d
-		else if (d->dcb->single_indirect != TBA) {
-			// Updating d
-			snorlax = DiskDriver_readBlock(disk, aux_node, d->dcb->single_indirect);
-			if (snorlax == TBA) {
-				printf ("ERROR READING @ AUX_indirect_dir_management()\n");
-				
-				// Freeing memory 
-				aux_node = NULL;
-				free (aux_node);
-				return;
-			}
-			d->indirect = aux_node;
-			d->current_block = &(aux_node->header);
-			d->pos_in_node = 0;
-			d->pos_in_block = 0;
+	BitMap_set(&fs->ibmap, voyager, OCCUPIED);
+	super->free_inodes -= 1;
+	return voyager;
+}
+
+// gives back to the table the iNode number ino
+// returns 0 on success, -1 on error
+int AUX_inode_free(iNodeFS* fs, int ino) {
+	if (ino < 0 || ino >= fs->super->num_inodes) return TBA;
+	if (!BitMap_isBitSet(&fs->ibmap, ino)) return 0;
+	BitMap_set(&fs->ibmap, ino, FREE);
+	fs->super->free_inodes += 1;
+	return 0;
+}
+
+// returns the block from which the blocks of node are placed:
+// the start of the allocation group of its iNode (after the iNode table)
+int AUX_node_hint(iNodeFS* fs, iNode* node) {
+	int group = node->header.block_in_disk / fs->super->inodes_per_group;
+	int hint = group << fs->disk->group_shift;
+	return (hint > fs->super->data_start) ? hint : fs->super->data_start;
+}
+
+// returns the free iNodes of the allocation group group, counted on the bitmap of the iNodes
+int AUX_group_free_inodes(iNodeFS* fs, int group) {
+	int start = group * fs->super->inodes_per_group;
+	int end = start + fs->super->inodes_per_group;
+	if (end > fs->super->num_inodes) end = fs->super->num_inodes;
+	
+	// Whole cells of the bitmap are counted at once
+	int occupied = 0;
+	for (int ino = start; ino < end; ) {
+		if (ino % NUMBITS == 0 && ino + NUMBITS <= end) {
+			occupied += __builtin_popcount(fs->ibmap.entries[ino / NUMBITS]);
+			ino += NUMBITS;
 		}
+		else occupied += BitMap_isBitSet(&fs->ibmap, ino++);
 	}
-	// We're in the single indirect
-	else {
-		if (d->indirect->header.block_in_disk == d->dcb->single_indirect && 
-			d->indirect->icb.upper == d->dcb->header.block_in_disk) {
-				
-			if (d->pos_in_node < indirect_idx_size) return;
-			else {
-				// double indirect also exists: just move there d
-				if (d->dcb->double_indirect != TBA) {
-					// Updating d
-					snorlax = DiskDriver_readBlock(disk, aux_node, d->dcb->double_indirect);
-					if (snorlax == TBA) {
-						printf ("ERROR READING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					d->indirect = aux_node;
-					d->current_block = &(aux_node->header);
-					d->pos_in_node = 0;
-					d->pos_in_block = 0;
-				}
-				// double indirect does not exists: create it and move there d
-				else if (d->dcb->double_indirect == TBA && mode == WRITE) {
-					memset(aux_node, 0, BLOCK_SIZE);
-					int voyager = DiskDriver_getFreeBlock(disk, 0);
-					if (voyager == TBA) {
-						printf ("ERROR DISK FULL @ AUX_indirect_dir_management()\n");
-						return;
-					}
-					
-					// Creating BlockHeader
-					BlockHeader header;
-					header.block_in_file = TBA;
-					header.block_in_node = DOUBLE;
-					header.block_in_disk = voyager;
-					
-					// Creating icb
-					iNodeControlBlock icb;
-					if (d->directory != NULL) {
-						icb.directory_block = d->directory->header.block_in_disk;
-					} else icb.directory_block = TBA;
-					icb.block_in_disk = header.block_in_disk;
-					icb.upper = d->dcb->header.block_in_disk;
-					icb.node_type = NOD;
-					
-					// NOD stuffs
-					aux_node->header = header;
-					aux_node->icb = icb;
-					aux_node->num_entries = 0;
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						aux_node->file_blocks[i] = TBA;
-					}
-					
-					// Writing on the disk
-					snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating d->dcb
-					d->dcb->double_indirect = aux_node->header.block_in_disk;
-					d->dcb->fcb.size_in_blocks += 1;
-					d->dcb->fcb.size_in_bytes += BLOCK_SIZE;
-					snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating d
-					d->indirect = aux_node;
-					d->current_block = &(aux_node->header);
-					d->pos_in_node = 0;
-					d->pos_in_block = 0;
-				}
-			}
+	return (end > start) ? (end - start) - occupied : 0;
+}
+
+// returns the first iNode of the allocation group where a new directory under parent goes:
+// among the groups with at least the average free iNodes, the one with the most free blocks,
+// so that the directories are spread on the disk and their files have room near them
+int AUX_dir_group(iNodeFS* fs, iNode* parent) {
+	DiskDriver* disk = fs->disk;
+	int num_groups = (fs->super->num_inodes + fs->super->inodes_per_group - 1) / fs->super->inodes_per_group;
+	if (num_groups > disk->num_groups) num_groups = disk->num_groups;
+	int average = fs->super->free_inodes / num_groups;
+	
+	// The group of the parent if nothing is better
+	int group = parent->header.block_in_disk / fs->super->inodes_per_group;
+	int best = TBA;
+	for (int i = 0; i < num_groups; ++i) {
+		int free_inodes = AUX_group_free_inodes(fs, i);
+		if (free_inodes == 0 || free_inodes < average) continue;
+		if (DiskDriver_groupFree(disk, i) > best) {
+			best = DiskDriver_groupFree(disk, i);
+			group = i;
 		}
-		// we are in the double indirect
-		else if (d->indirect->header.block_in_disk == d->dcb->double_indirect &&
-				d->indirect->icb.upper == d->dcb->header.block_in_disk) {
-		
-			if (d->pos_in_node < indirect_idx_size) {
-				// Need to create another NOD, then update d
-				if (d->indirect->file_blocks[d->pos_in_block] == TBA && mode == WRITE) {
-					memset(aux_node, 0, BLOCK_SIZE);
-					int voyager = DiskDriver_getFreeBlock(disk, 0);
-					if (voyager == TBA) {
-						printf ("ERROR DISK FULL @ AUX_indirect_dir_management()\n");
-						return;
-					}
-					
-					// Creating BlockHeader
-					BlockHeader header;
-					header.block_in_file = TBA;
-					header.block_in_node = d->pos_in_node;
-					header.block_in_disk = voyager;
-					
-					// Creating icb
-					iNodeControlBlock icb;
-					if (d->directory != NULL) {
-						icb.directory_block = d->directory->header.block_in_disk;
-					} else icb.directory_block = TBA;
-					icb.block_in_disk = header.block_in_disk;
-					icb.upper = d->indirect->header.block_in_disk;
-					icb.node_type = NOD;
-					
-					// NOD Stuffs
-					aux_node->header = header;
-					aux_node->icb = icb;
-					aux_node->num_entries = 0;
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						aux_node->file_blocks[i] = TBA;
-					}
-					
-					// Writing on the disk
-					snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating d->indirect
-					d->indirect->file_blocks[d->pos_in_block] = aux_node->header.block_in_disk;
-					snorlax = DiskDriver_writeBlock(disk, d->indirect, d->indirect->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating d->dcb
-					d->dcb->fcb.size_in_blocks += 1;
-					d->dcb->fcb.size_in_bytes += BLOCK_SIZE;
-					snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating d
-					d->indirect = aux_node;
-					d->current_block = &(aux_node->header);
-					d->pos_in_node = 0;
-					d->pos_in_block = 0;
-				}
-				// double indirect's NOD also exists. Just Update d
-				else {
-					snorlax = DiskDriver_readBlock(disk, aux_node, d->indirect->file_blocks[d->pos_in_block]);
-					if (snorlax == TBA) {
-						printf ("ERROR READING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating d
-					d->indirect = aux_node;
-					d->current_block = &(aux_node->header);
-					d->pos_in_node = 0;
-					d->pos_in_block = 0;
-				}
-			}
-			// NO MORE SPACE
-			else {
-				printf ("TOO LARGE DIR @ AUX_indirect_dir_management()\n");
-				return;
-			}
+	}
+	return group * fs->super->inodes_per_group;
+}
+
+// splits the position pos in a file in its block in file and its position in that block.
+// The block size is a power of two, so it's a shift and a mask
+void AUX_locate(DiskDriver* disk, int64_t pos, int* block_in_file, int* pos_in_block) {
+	*block_in_file = pos >> disk->block_shift;
+	*pos_in_block = pos & (disk->block_size - 1);
+}
+
+// empties the scratch pool (without freeing what's in it)
+void AUX_pool_init(ScratchPool* pool) {
+	pool->free_blocks = NULL;
+	pool->free_handles = NULL;
+	pool->blocks = 0;
+	pool->handles = 0;
+}
+
+// returns a block-sized buffer from the scratch pool of fs, allocating it only if the pool is empty
+void* AUX_scratch_get(iNodeFS* fs) {
+	ScratchPool* pool = &fs->pool;
+	void* block = pool->free_blocks;
+	if (block == NULL) {
+		pool->blocks += 1;
+		return malloc(fs->disk->block_size);
+	}
+	pool->free_blocks = *(void**) block;
+	return block;
+}
+
+// gives back to the scratch pool of fs a buffer returned by AUX_scratch_get
+void AUX_scratch_put(iNodeFS* fs, void* block) {
+	if (block == NULL) return;
+	*(void**) block = fs->pool.free_blocks;
+	fs->pool.free_blocks = block;
+}
+
+// returns a FileHandle from the scratch pool of fs, allocating it only if the pool is empty
+FileHandle* AUX_handle_get(iNodeFS* fs) {
+	ScratchPool* pool = &fs->pool;
+	FileHandle* f = (FileHandle*) pool->free_handles;
+	if (f == NULL) {
+		pool->handles += 1;
+		return (FileHandle*) malloc(sizeof(FileHandle));
+	}
+	pool->free_handles = *(void**) f;
+	return f;
+}
+
+// gives back to the scratch pool of fs a FileHandle returned by AUX_handle_get
+void AUX_handle_put(iNodeFS* fs, FileHandle* f) {
+	if (f == NULL) return;
+	*(void**) f = fs->pool.free_handles;
+	fs->pool.free_handles = f;
+}
+
+// frees the buffers and the FileHandles kept in the scratch pool, and empties it
+void AUX_pool_free(ScratchPool* pool) {
+	while (pool->free_blocks != NULL) {
+		void* block = pool->free_blocks;
+		pool->free_blocks = *(void**) block;
+		free (block);
+	}
+	while (pool->free_handles != NULL) {
+		void* f = pool->free_handles;
+		pool->free_handles = *(void**) f;
+		free (f);
+	}
+	AUX_pool_init(pool);
+}
+
+// empties the iNode cache and resets its counters
+void AUX_icache_init(iNodeCache* ic) {
+	for (int i = 0; i < ICACHE_BUCKETS; ++i) {
+		ic->buckets[i] = NULL;
+	}
+	ic->free_nodes = NULL;
+	ic->cached = 0;
+	ic->wb_bytes = 0;
+	ic->hits = 0;
+	ic->misses = 0;
+}
+
+// frees the nodes of the iNode cache, the ones in use and the free ones, with their write-back buffers,
+// and empties it. The nodes are not written back
+void AUX_icache_free(iNodeCache* ic) {
+	for (int i = 0; i < ICACHE_BUCKETS; ++i) {
+		while (ic->buckets[i] != NULL) {
+			CachedNode* cached = ic->buckets[i];
+			ic->buckets[i] = cached->next;
+			cached->next = ic->free_nodes;
+			ic->free_nodes = cached;
 		}
-		// We are in a double indirect NOD
-		else if (d->indirect->icb.upper == d->dcb->double_indirect &&
-				d->indirect->header.block_in_disk != d->dcb->double_indirect) {
-			// Check if it's full. if so, move to next one
-			// If the next one does not exists, create and move
-			if (d->pos_in_node < indirect_idx_size) return;
-			else {
-				// Read the parent node.
-				snorlax = DiskDriver_readBlock(disk, aux_node, d->indirect->icb.upper);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ AUX_indirect_dir_management()\n");
-					
-					// Freeing memory)
-					aux_node = NULL;
-					free (aux_node);
-					return;
-				}
-				// check if the next NOD exists.
-				// if exists, move					
-				if (aux_node->file_blocks[d->indirect->header.block_in_node+1] != TBA) {
-					snorlax = DiskDriver_readBlock(disk, aux_node, aux_node->file_blocks[d->indirect->header.block_in_node+1]);
-					if (snorlax == TBA) {
-					printf ("ERROR READING @ AUX_indirect_dir_management()\n");
-					
-					// Freeing memory)
-					aux_node = NULL;
-					free (aux_node);
-					return;
-					}
-					
-					d->indirect = aux_node;
-					d->current_block = &(aux_node->header);
-					d->pos_in_node = 0;
-					d->pos_in_block = 0;					
-				}
-				// else if it does not exists AND mod == WRITE, create and move
-				else if (aux_node->file_blocks[d->indirect->header.block_in_node+1] == TBA &&
-						mode == WRITE) {
-					iNode_indirect* another_node = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-					memset(another_node, 0, BLOCK_SIZE);
-					int voyager = DiskDriver_getFreeBlock(disk, 0);
-					if (voyager == TBA) {
-						printf ("ERROR DISK FULL @ AUX_indirect_dir_management()\n");
-						return;
-					}
-					
-					// Creating blockheader
-					BlockHeader header;
-					header.block_in_file = TBA;
-					header.block_in_node = d->indirect->header.block_in_node+1;
-					header.block_in_disk = voyager;
-					
-					// Creating icb
-					iNodeControlBlock icb;
-					if (d->directory != NULL) {
-						icb.directory_block = d->directory->header.block_in_disk;
-					} else icb.directory_block = TBA;
-					icb.block_in_disk = header.block_in_disk;
-					icb.upper = aux_node->header.block_in_disk;
-					icb.node_type = NOD;
-					
-					// NOD stuffs
-					another_node->header = header;
-					another_node->icb = icb;
-					another_node->num_entries = 0;
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						another_node->file_blocks[i] = TBA;
-					}
-					
-					// Writing on the disk
-					snorlax = DiskDriver_writeBlock(disk, another_node, another_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						another_node = NULL;
-						free (another_node);
-						return;
-					}
-					
-					// Updating aux_node
-					aux_node->file_blocks[another_node->header.block_in_node] = another_node->header.block_in_disk;
-					snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						another_node = NULL;
-						free (another_node);
-						return;
-					}
-					
-					// Update d->dcb sizes
-					d->dcb->fcb.size_in_blocks += 1;
-					d->dcb->fcb.size_in_bytes += BLOCK_SIZE;
-					snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						another_node = NULL;
-						free (another_node);
-						return;
-					}
-					
-					// Updating d
-					d->indirect = another_node;
-					d->current_block = &(another_node->header);
-					d->pos_in_node = 0;
-					d->pos_in_block = 0;
-					
-					// Freeing aux_node
-					aux_node = NULL;
-					free (aux_node);
-				}
-			}
+	}
+	while (ic->free_nodes != NULL) {
+		CachedNode* cached = ic->free_nodes;
+		ic->free_nodes = cached->next;
+		free (cached->wb_data);
+		free (cached);
+	}
+	AUX_icache_init(ic);
+}
+
+// returns the cached iNode number ino, reading it from the table if it's not in the cache
+// it takes a reference to the node, to be dropped with AUX_iput
+// returns null on error
+iNode* AUX_iget(iNodeFS* fs, int ino) {
+	if (ino < 0) return NULL;
+	iNodeCache* ic = &fs->icache;
+	CachedNode** bucket = &ic->buckets[ino % ICACHE_BUCKETS];
+	
+	// Hit
+	for (CachedNode* cached = *bucket; cached != NULL; cached = cached->next) {
+		if (cached->node.header.block_in_disk == ino && !cached->removed) {
+			ic->hits += 1;
+			cached->refcount += 1;
+			return &cached->node;
 		}
 	}
 	
+	// Miss: reading the node and putting it in its bucket
+	ic->misses += 1;
+	CachedNode* cached = ic->free_nodes;
+	if (cached != NULL) ic->free_nodes = cached->next;
+	else {
+		cached = (CachedNode*) malloc(offsetof(CachedNode, node) + INODE_SIZE);
+		cached->wb_data = NULL;
+		cached->wb_cap = 0;
+	}
+	int snorlax = AUX_inode_read(fs, ino, &cached->node);
+	if (snorlax) {
+		cached->next = ic->free_nodes;
+		ic->free_nodes = cached;
+		return NULL;
+	}
+	cached->refcount = 1;
+	cached->dirty = 0;
+	cached->removed = 0;
+	cached->wb_len = 0;
+	cached->next = *bucket;
+	*bucket = cached;
+	ic->cached += 1;
+	
+	return &cached->node;
 }
 
+// returns the CachedNode of a cached iNode
+CachedNode* AUX_cached(iNode* node) {
+	return (CachedNode*) ((char*) node - offsetof(CachedNode, node));
+}
 
-// creates an empty file in the directory d
-// returns null on error (file existing, no free blocks)
-// an empty file consists only of a iNode block of type FIL
-FileHandle* iNodeFS_createFile(DirectoryHandle* d, const char* filename) {
+// takes another reference to a cached iNode
+void AUX_iref(iNode* node) {
+	if (node != NULL) AUX_cached(node)->refcount += 1;
+}
+
+// drops a reference to a cached iNode. When it's the last one, the node is written back
+// (if dirty) and leaves the cache. A removed node gives back the blocks it still has
+// returns 0 on success, -1 on error
+int AUX_iput(iNodeFS* fs, iNode* node) {
+	if (node == NULL) return 0;
+	CachedNode* cached = AUX_cached(node);
+	cached->refcount -= 1;
+	if (cached->refcount > 0) return 0;
+	
+	// The buffered data changes the node, so it goes first
+	int ret = AUX_wb_flush(fs, node);
+	if (cached->dirty && !cached->removed) {
+		if (AUX_inode_write(fs, node) == TBA) ret = TBA;
+		if (ret == TBA) printf ("ERROR WRITING @ AUX_iput()\n");
+	}
 	
-	// Preliminary stuffs
-	if (d == NULL) return NULL;
-	if (d->infs == NULL) return NULL;
-	DiskDriver* disk = d->infs->disk;
-	if (d == NULL) return NULL;
+	// The blocks of a removed file were freed by iNodeFS_remove: the ones it still has
+	// were taken later through a handle that was open on it, and nobody else can free them
+	if (cached->removed && AUX_free_node_blocks(fs->disk, node) == TBA) {
+		printf ("ERROR FREEING BLOCKS @ AUX_iput()\n");
+		ret = TBA;
+	}
 	
-	// Creating an iNode struct to store what I need
-	iNode* aux_node = (iNode*) malloc(sizeof(iNode));
-	int snorlax = TBA;
-	int filecount = 0;
-	
-	// Creating a copy of the dirhandle and searching for an already existent file
-	// daux is set to first block of main inode to start the search
-	// first_free_occurrency will be lately set as a duplicate of daux
-	int first_free_flag = TBA;
-	DirectoryHandle* daux = AUX_duplicate_dirhandle(d);
-	daux->indirect = NULL;
-	daux->current_block = &(daux->dcb->header);
-	daux->pos_in_node = 0;
-	daux->pos_in_block = 0;
-	DirectoryHandle* first_free_occurrency;
-	
-	// Search in the main inode
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (daux->dcb->file_blocks[i] == TBA) {
-			// Update the flag and save the first free occurrence
-			if (first_free_flag == TBA) {
-				first_free_flag = 0;
-				first_free_occurrency = AUX_duplicate_dirhandle(daux);
+	// Leaving the cache
+	CachedNode** voyager = &fs->icache.buckets[node->header.block_in_disk % ICACHE_BUCKETS];
+	while (*voyager != NULL && *voyager != cached) voyager = &(*voyager)->next;
+	if (*voyager != NULL) *voyager = cached->next;
+	fs->icache.cached -= 1;
+	cached->next = fs->icache.free_nodes;
+	fs->icache.free_nodes = cached;
+	
+	return ret;
+}
+
+// marks a cached iNode as modified: it's written back when it leaves the cache or at iNodeFS_sync
+void AUX_idirty(iNode* node) {
+	if (node != NULL) AUX_cached(node)->dirty = 1;
+}
+
+// marks a cached iNode as removed from the disk: it's never written back
+void AUX_idrop(iNode* node) {
+	if (node != NULL) AUX_cached(node)->removed = 1;
+}
+
+// writes back on the disk all the modified iNodes in the cache
+// returns 0 on success, -1 on error
+int iNodeFS_sync(iNodeFS* fs) {
+	if (fs == NULL || fs->disk == NULL) return TBA;
+	int ret = AUX_wb_flush_all(fs);
+	for (int i = 0; i < ICACHE_BUCKETS; ++i) {
+		for (CachedNode* cached = fs->icache.buckets[i]; cached != NULL; cached = cached->next) {
+			if (!cached->dirty || cached->removed) continue;
+			if (AUX_inode_write(fs, &cached->node) == TBA) {
+				printf ("ERROR WRITING @ iNodeFS_sync()\n");
+				ret = TBA;
 			}
+			else cached->dirty = 0;
 		}
-		// Reading the node to check for equal file name
-		// if snorlax == TBA, the block is free according to the bitmap
-		// else check the node name
-		else {
-			++filecount;
-			snorlax = DiskDriver_readBlock(disk, aux_node, daux->dcb->file_blocks[i]);
-			if (snorlax != TBA) {
-				if (aux_node->fcb.icb.node_type == FIL && strcmp(aux_node->fcb.name, filename) == 0) {
-					printf ("FILE %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_createFile()\n", filename);
-								
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);		
-					daux = NULL;
-					free(daux);
-					first_free_occurrency = NULL;
-					free (first_free_occurrency);
-		
-					return NULL;
-				}
-				daux->current_block = &(aux_node->header);
-			}
+	}
+	return ret;
+}
+
+// unmounts the file system fs: d (the handle returned by iNodeFS_init) gives back its iNodes and is freed,
+// everything is written back on the disk, and the memory of the caches and of the scratch pool is freed.
+// The FileHandles still open are not valid anymore. The disk stays mapped (see DiskDriver_unmap)
+// returns 0 on success, -1 on error
+int iNodeFS_unmount(iNodeFS* fs, DirectoryHandle* d) {
+	if (fs == NULL || fs->disk == NULL) return TBA;
+	int ret = 0;
+	if (d != NULL) {
+		if (AUX_iput(fs, d->dcb) == TBA) ret = TBA;
+		if (AUX_iput(fs, d->directory) == TBA) ret = TBA;
+		free (d);
+	}
+	if (iNodeFS_sync(fs) == TBA) ret = TBA;
+	
+	// Freeing memory
+	AUX_icache_free(&fs->icache);
+	AUX_pool_free(&fs->pool);
+	AUX_dcache_init(&fs->dcache);
+	
+	return ret;
+}
+
+// returns the hash of a name (FNV-1a), stored in its DirectoryEntry
+uint32_t AUX_name_hash(const char* name) {
+	uint32_t hash = 2166136261u;
+	for (int i = 0; name[i] != '\0'; ++i) {
+		hash ^= (uint8_t) name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// initializes an empty DirectoryBlock: a single free entry that covers all of it
+void AUX_db_init(DiskDriver* disk, DirectoryBlock* db) {
+	db->next = TBA;
+	DirectoryEntry* entry = (DirectoryEntry*) db->entries;
+	entry->block_in_disk = TBA;
+	entry->rec_len = DB_ENTRIES_SIZE(disk);
+}
+
+// returns the number of DirectoryBlocks of dir, the end of its last extent
+// (a directory has no holes: its blocks are never freed while it exists)
+int AUX_dir_blocks(DiskDriver* disk, iNode* dir) {
+	return AUX_extent_end(disk, dir);
+}
+
+// searches in the DirectoryBlock db the entry named name of type node_type (ANY for both)
+// returns its offset in db->entries, -1 if it's not there
+int AUX_db_search(DiskDriver* disk, DirectoryBlock* db, uint32_t hash, const char* name, int name_len, int node_type) {
+	DirectoryEntry* entry = NULL;
+	
+	// The names are compared only if the hashes are equal
+	for (int offset = 0; offset < DB_ENTRIES_SIZE(disk); offset += entry->rec_len) {
+		entry = (DirectoryEntry*) (db->entries + offset);
+		if (entry->rec_len == 0) break;
+		if (entry->block_in_disk != TBA && entry->hash == hash && entry->name_len == name_len &&
+				(node_type == ANY || entry->node_type == node_type) &&
+				memcmp(entry->name, name, name_len) == 0) {
+			return offset;
 		}
-		++daux->pos_in_node;
-	}
-	// Manager call
-	// Check if we are in the single indirect
-	if (filecount == daux->pos_in_node) {
-		AUX_indirect_dir_management(daux, WRITE);
-	} else {
-		AUX_indirect_dir_management(daux, READ);
-	}
-
-	filecount = 0;
-	if (daux->indirect != NULL && daux->indirect->header.block_in_disk == daux->dcb->single_indirect) {
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (daux->indirect->file_blocks[i] == TBA) {
-				// Update the flag and save the first free occurrence
-				if (first_free_flag == TBA) {
-					first_free_flag = 0;
-					first_free_occurrency = AUX_duplicate_dirhandle(daux);
-				}
-			}
-			// Reading the node to check for equal file name
-			else {
-				++filecount;
-				snorlax = DiskDriver_readBlock(disk, aux_node, daux->indirect->file_blocks[i]);
-				if (snorlax != TBA) {
-					if (aux_node->fcb.icb.node_type == FIL && strcmp(aux_node->fcb.name, filename) == 0){
-						printf ("FILE %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_createFile()\n", filename);
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						daux = NULL;
-						free (daux);
-						first_free_occurrency = NULL;
-						free (first_free_occurrency);
-						
-						return NULL;
-					}
-					daux->current_block = &(aux_node->header);
-				}
-			}
-			++daux->pos_in_node;
+	}
+	return TBA;
+}
+
+// finds in the DirectoryBlock db a free entry of at least needed bytes,
+// splitting the slack of a used entry if there is no free one
+// returns the entry, with its rec_len set, or NULL if db is full
+DirectoryEntry* AUX_db_slot(DiskDriver* disk, DirectoryBlock* db, int needed) {
+	DirectoryEntry* entry = NULL;
+	DirectoryEntry* new_entry = NULL;
+	int used = 0;
+	
+	for (int offset = 0; offset < DB_ENTRIES_SIZE(disk); offset += entry->rec_len) {
+		entry = (DirectoryEntry*) (db->entries + offset);
+		if (entry->rec_len == 0) break;
+		
+		// A free entry large enough
+		if (entry->block_in_disk == TBA && entry->rec_len >= needed) return entry;
+		
+		// An entry with enough space after its name: splitting it
+		used = DIR_ENTRY_SIZE(entry->name_len);
+		if (entry->block_in_disk != TBA && entry->rec_len - used >= needed) {
+			new_entry = (DirectoryEntry*) (db->entries + offset + used);
+			new_entry->rec_len = entry->rec_len - used;
+			entry->rec_len = used;
+			return new_entry;
 		}
 	}
+	return NULL;
+}
 
-	// Manager call
-	// Check if we are in the single indirect
-	if (filecount == daux->pos_in_node) {
-		AUX_indirect_dir_management(daux, WRITE);
-	} else {
-		AUX_indirect_dir_management(daux, READ);
-	}
-/*	
-	printf ("daux pos in node: %d\n", daux->pos_in_node);
-	printf ("daux pos in block: %d\n", daux->pos_in_node);
-	if (daux->indirect != NULL) printf ("daux indirect: %d\n", daux->indirect->icb.block_in_disk);
-	else printf ("daux is on the main node\n");
-	printf ("daux current block: %d\n", daux->current_block->block_in_disk);
-		printf ("FFO pos in node: %d\n", first_free_occurrency->pos_in_node);
-	printf ("FFO pos in block: %d\n", first_free_occurrency->pos_in_node);
-	if (daux->indirect != NULL) printf ("FFO indirect: %d\n", first_free_occurrency->indirect->icb.block_in_disk);
-	else printf ("FFO is on the main node\n");
-	printf ("FFO current block: %d\n\n", first_free_occurrency->current_block->block_in_disk);
-*/	
-	
-	if (daux->indirect != NULL && daux->indirect->header.block_in_disk == daux->dcb->double_indirect) {
+// searches the entry named name of type node_type (ANY for both) in the directory dir
+// only the DirectoryBlocks of dir are read, not the iNodes of its files. If dir is indexed
+// only the bucket of the name is read
+// if found, entry_block and entry_offset (if not NULL) are set to the position of the entry
+// returns the block of the entry's iNode, -1 if it does not exist
+int AUX_dir_lookup(DiskDriver* disk, iNode* dir, const char* name, int node_type, int* entry_block, int* entry_offset) {
+	
+	uint32_t hash = AUX_name_hash(name);
+	int name_len = strlen(name);
+	int voyager = TBA;
+	int offset = TBA;
+	int ret = TBA;
+	DirectoryBlock* aux_db = NULL;
+	DirectoryEntry* entry = NULL;
+	
+	// Unindexed: all the DirectoryBlocks in order, until the first missing one
+	// Indexed: the bucket of the name and its overflow blocks
+	int i = (dir->index_buckets > 0) ? (int) (hash % dir->index_buckets) : 0;
+	while (i != TBA && ret == TBA) {
+		voyager = AUX_file_block(disk, dir, i, TBA, READ);
+		if (voyager == TBA) break;
+		aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_READ);
+		if (aux_db == NULL) {
+			printf ("ERROR READING @ AUX_dir_lookup()\n");
+			break;
+		}
+		
+		offset = AUX_db_search(disk, aux_db, hash, name, name_len, node_type);
+		if (offset != TBA) {
+			entry = (DirectoryEntry*) (aux_db->entries + offset);
+			ret = entry->block_in_disk;
+			if (entry_block != NULL) *entry_block = voyager;
+			if (entry_offset != NULL) *entry_offset = offset;
+		}
 		
-		int upper_pos = daux->indirect->header.block_in_disk;
+		i = (dir->index_buckets > 0) ? aux_db->next : i + 1;
+		DiskDriver_releaseBlock(disk, aux_db);
+	}
+	
+	return ret;
+}
+
+// places in the directory dir an entry for the iNode in block_in_disk
+// unindexed: in the first DirectoryBlock with enough space, or in a new one
+// indexed: in the bucket of the name, or in a new overflow block of it
+// dir is updated only in memory (the caller writes it)
+// returns 0 on success, -1 on error
+int AUX_dir_insert(iNodeFS* fs, iNode* dir, const char* name, int node_type, int block_in_disk) {
+	
+	DiskDriver* disk = fs->disk;
+	int needed = DIR_ENTRY_SIZE(strlen(name));
+	int hint = AUX_node_hint(fs, dir);
+	int voyager = TBA;
+	int next = TBA;
+	DirectoryBlock* aux_db = NULL;
+	DirectoryBlock* aux_next = NULL;
+	DirectoryEntry* new_entry = NULL;
+	
+	int i = (dir->index_buckets > 0) ? (int) (AUX_name_hash(name) % dir->index_buckets) : 0;
+	while (new_entry == NULL) {
+		voyager = AUX_file_block(disk, dir, i, hint, READ);
 		
-		if (daux->indirect->file_blocks[daux->pos_in_node] == TBA) {
-			AUX_indirect_dir_management(daux, WRITE);
-		} else {
-			AUX_indirect_dir_management(daux, READ);
+		// No space in the existing blocks: creating a new one
+		if (voyager == TBA) {
+			voyager = AUX_file_block(disk, dir, i, hint, WRITE);
+			if (voyager == TBA) {
+				printf ("ERROR DISK FULL @ AUX_dir_insert()\n");
+				return TBA;
+			}
+			aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE);
+			AUX_db_init(disk, aux_db);
 		}
+		else aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE);
+		if (aux_db == NULL) {
+			printf ("ERROR READING @ AUX_dir_insert()\n");
+			return TBA;
+		}
+		hint = voyager + 1;
 		
-		iNode_indirect* upper = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, upper, upper_pos);
-		if (snorlax == TBA) {
-			printf ("ERROR READING @ iNodeFS_createFile()\n");
-			
-			// Freeing memory
-			aux_node = NULL;
-			free (aux_node);
-			daux = NULL;
-			free (daux);
-			first_free_occurrency = NULL;
-			free (first_free_occurrency);
-			upper = NULL;
-			free (upper);
-			
-			return NULL;
+		new_entry = AUX_db_slot(disk, aux_db, needed);
+		if (new_entry != NULL) {
+			new_entry->block_in_disk = block_in_disk;
+			new_entry->hash = AUX_name_hash(name);
+			new_entry->name_len = strlen(name);
+			new_entry->node_type = node_type;
+			memcpy(new_entry->name, name, new_entry->name_len);
 		}
 		
-		// Now daux is on a NOD. The behavior shold be the same as in a single_indirect:
-		// Calling the manager at this point will automatically create another NOD if needed
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			
-			if (upper->file_blocks[i] != TBA) {
-				filecount = 0;
-				if (daux->indirect != NULL && daux->indirect->icb.upper == daux->dcb->double_indirect) {
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						if (daux->indirect->file_blocks[i] == TBA) {
-							// Update flag and save first free occurrency
-							if (first_free_flag == TBA) {
-								first_free_flag = 0;
-								first_free_occurrency = AUX_duplicate_dirhandle(daux);
-							}
-						}
-						// Reading the node to check for equal file name
-						else {
-							++filecount;
-							snorlax = DiskDriver_readBlock(disk, aux_node, daux->indirect->file_blocks[i]);
-							if (snorlax != TBA) {
-								if (aux_node->fcb.icb.node_type == FIL && strcmp(aux_node->fcb.name, filename) == 0) {
-									printf ("FILE %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_createFile()\n", filename);
-						
-									// Freeing memory
-									aux_node = NULL;
-									free (aux_node);
-									daux = NULL;
-									free (daux);
-									first_free_occurrency = NULL;
-									free (first_free_occurrency);
-									upper = NULL;
-									free (upper);
-									
-									return NULL;
-								}
-								daux->current_block = &(aux_node->header);
-							}
-						}
-						++daux->pos_in_node;
-					}
+		// Going on in the bucket, linking a new overflow block at its end if needed
+		// (only once it's allocated, so that on error the bucket is left as it was)
+		else if (dir->index_buckets > 0) {
+			next = aux_db->next;
+			if (next == TBA) {
+				next = AUX_dir_blocks(disk, dir);
+				voyager = AUX_file_block(disk, dir, next, hint, WRITE);
+				if (voyager == TBA) {
+					DiskDriver_releaseBlock(disk, aux_db);
+					printf ("ERROR DISK FULL @ AUX_dir_insert()\n");
+					return TBA;
 				}
-				if (filecount == daux->pos_in_node) {
-					AUX_indirect_dir_management(daux, WRITE);
-				} else {
-					AUX_indirect_dir_management(daux, READ);
+				aux_next = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE);
+				if (aux_next == NULL) {
+					DiskDriver_releaseBlock(disk, aux_db);
+					printf ("ERROR READING @ AUX_dir_insert()\n");
+					return TBA;
 				}
-				snorlax = DiskDriver_readBlock(disk, upper, upper->header.block_in_disk);
-				if (snorlax == TBA) {			
-					printf ("ERROR READING @ iNodeFS_mkdir()\n");
-							
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);		
-					daux = NULL;
-					free(daux);
-					first_free_occurrency = NULL;
-					free (first_free_occurrency);
-					upper = NULL;
-					free (upper);
-
-					return NULL;
-				} 
+				AUX_db_init(disk, aux_next);
+				DiskDriver_releaseBlock(disk, aux_next);
+				aux_db->next = next;
 			}
-			else {
-				upper = NULL;
-				free (upper);
+		}
+		else next = i + 1;
+		
+		DiskDriver_releaseBlock(disk, aux_db);
+		i = next;
+	}
+	
+	return 0;
+}
+
+// rebuilds the directory dir with a hashed index of the given number of buckets
+// (0 to go back to an unindexed directory), moving all its entries in new DirectoryBlocks
+// dir is updated only in memory (the caller writes it). On error it's left as it was
+// returns 0 on success, -1 on error
+int AUX_dir_reindex(iNodeFS* fs, iNode* dir, int buckets) {
+	
+	DiskDriver* disk = fs->disk;
+	// Collecting all the entries
+	int blocks = AUX_dir_blocks(disk, dir);
+	DirectoryEntry** entries = (DirectoryEntry**) malloc((dir->num_entries + 1) * sizeof(DirectoryEntry*));
+	DirectoryBlock* aux_db = NULL;
+	DirectoryEntry* entry = NULL;
+	int voyager = TBA;
+	int count = 0;
+	int ret = 0;
+	
+	for (int i = 0; i < blocks && ret == 0; ++i) {
+		voyager = AUX_file_block(disk, dir, i, TBA, READ);
+		aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_READ);
+		if (aux_db == NULL) {
+			printf ("ERROR READING @ AUX_dir_reindex()\n");
+			ret = TBA;
+			break;
+		}
+		for (int offset = 0; offset < DB_ENTRIES_SIZE(disk); offset += entry->rec_len) {
+			entry = (DirectoryEntry*) (aux_db->entries + offset);
+			if (entry->rec_len == 0) break;
+			if (entry->block_in_disk == TBA) continue;
+			if (count == dir->num_entries) {
+				printf ("ERROR TOO MANY ENTRIES @ AUX_dir_reindex()\n");
+				ret = TBA;
 				break;
 			}
 			
+			// Keeping a NUL terminated copy of the entry
+			entries[count] = (DirectoryEntry*) malloc(sizeof(DirectoryEntry) + entry->name_len + 1);
+			memcpy(entries[count], entry, sizeof(DirectoryEntry) + entry->name_len);
+			entries[count]->name[entry->name_len] = '\0';
+			++count;
 		}
-		
+		DiskDriver_releaseBlock(disk, aux_db);
 	}
 	
-	// Creation time
-	memset(aux_node, 0, BLOCK_SIZE);
-	int voyager = DiskDriver_getFreeBlock(disk, 0);
-	if (voyager == TBA) {
-		printf ("ERROR - DISK COULD BE FULL @ iNodeFS_createFile()\n");
-		
-		// Freeing memory		
-		daux = NULL;
-		free(daux);
-		
-		return NULL;
+	// Creating the buckets and putting back the entries in a copy of dir with no blocks,
+	// so that dir keeps its old DirectoryBlocks until the new ones hold all the entries
+	iNode* aux_dir = (iNode*) AUX_scratch_get(fs);
+	memcpy(aux_dir, dir, INODE_SIZE);
+	aux_dir->index_buckets = buckets;
+	aux_dir->depth = 0;
+	aux_dir->num_extents = 0;
+	aux_dir->fcb.size_in_blocks = 0;
+	aux_dir->fcb.size_in_bytes = 0;
+	for (int i = 0; i < buckets && ret == 0; ++i) {
+		voyager = AUX_file_block(disk, aux_dir, i, AUX_node_hint(fs, aux_dir), WRITE);
+		aux_db = (voyager != TBA) ? (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE) : NULL;
+		if (aux_db == NULL) {
+			printf ("ERROR DISK FULL @ AUX_dir_reindex()\n");
+			ret = TBA;
+			break;
+		}
+		AUX_db_init(disk, aux_db);
+		DiskDriver_releaseBlock(disk, aux_db);
 	}
+	for (int i = 0; i < count; ++i) {
+		if (ret == 0) ret = AUX_dir_insert(fs, aux_dir, entries[i]->name, entries[i]->node_type, entries[i]->block_in_disk);
+		free (entries[i]);
+	}
+	free (entries);
 	
-	// Header creation
-	BlockHeader header;
-	header.block_in_file = TBA;
-	header.block_in_node = daux->pos_in_node;
-	header.block_in_disk = voyager;
-	
-	// iNode Control Block creation
-	iNodeControlBlock icb;
-	icb.directory_block = d->dcb->header.block_in_disk;
-	icb.block_in_disk = voyager;
-	icb.upper = TBA;
-	icb.node_type = FIL;
-	
-	// File Control Block creation
-	FileControlBlock fcb;
-	fcb.size_in_bytes = BLOCK_SIZE;
-	fcb.size_in_blocks = 1;
-	fcb.icb = icb;
-	strcpy(fcb.name, filename);
-	
-	// Compacting all
-	aux_node->header = header;
-	aux_node->fcb = fcb;
-	aux_node->num_entries = 0;
-	aux_node->single_indirect = TBA;
-	aux_node->double_indirect = TBA;
-	for (int i = 0; i < inode_idx_size; ++i) {
-		aux_node->file_blocks[i] = TBA;
+	// Swapping the blocks: the old ones are freed only now. On error the new ones are dropped
+	if (ret == 0) {
+		ret = AUX_free_node_blocks(disk, dir);
+		memcpy(dir, aux_dir, INODE_SIZE);
 	}
+	else AUX_free_node_blocks(disk, aux_dir);
+	AUX_scratch_put(fs, aux_dir);
 	
-	// Writing on the disk
-	snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
+	return ret;
+}
+
+// adds to the directory dir an entry for the iNode in block_in_disk
+// the directory gets indexed once it's larger than DIR_INDEX_THRESHOLD blocks,
+// and the index doubles its buckets once they have on average an overflow block
+// updates dir (written back by the iNode cache)
+// returns 0 on success, -1 on error
+int AUX_dir_add(iNodeFS* fs, iNode* dir, const char* name, int node_type, int block_in_disk) {
+	
+	DiskDriver* disk = fs->disk;
+	int snorlax = 0;
+	int blocks = AUX_dir_blocks(disk, dir);
+	if (dir->index_buckets == 0 && DIR_INDEX_THRESHOLD > 0 && blocks >= DIR_INDEX_THRESHOLD) {
+		int buckets = DIR_INDEX_MIN;
+		while (buckets < blocks && buckets < DIR_INDEX_MAX) buckets *= 2;
+		snorlax = AUX_dir_reindex(fs, dir, buckets);
+	}
+	else if (dir->index_buckets > 0 && dir->index_buckets < DIR_INDEX_MAX && blocks >= 2 * dir->index_buckets) {
+		snorlax = AUX_dir_reindex(fs, dir, 2 * dir->index_buckets);
+	}
 	if (snorlax == TBA) {
-		printf ("ERROR WRITING AUX NODE ON THE DISK @ iNodeFS_createFile()\n");
-		
-		// Freeing memory
-		aux_node = NULL;
-		free (aux_node);		
-		daux = NULL;
-		free(daux);
-		
-		return NULL;
+		printf ("ERROR INDEXING @ AUX_dir_add()\n");
+		return TBA;
 	}
 	
-	// Creating the filehandle
-	FileHandle* filehandle = (FileHandle*) malloc(sizeof(FileHandle));
-	filehandle->infs = d->infs;
-	filehandle->fcb = aux_node;
-	filehandle->directory = d->dcb;
-	filehandle->indirect = d->indirect;
-	filehandle->current_block = &(aux_node->header);
-	filehandle->pos_in_node = 0;
-	filehandle->pos_in_block = 0;
+	snorlax = AUX_dir_insert(fs, dir, name, node_type, block_in_disk);
+	if (snorlax == TBA) return TBA;
 	
-	/*** Must work on free_first_occurrency ***/
+	// Updating dir
+	dir->num_entries += 1;
+	AUX_idirty(dir);
 	
-	// Updating dirhandle
-	// We are in the main inode
-	if (first_free_occurrency->indirect == NULL) {
-		d->dcb->file_blocks[first_free_occurrency->pos_in_node] = voyager;
+	return 0;
+}
+
+// empties the dentry cache and resets its counters
+void AUX_dcache_init(DentryCache* dc) {
+	for (int i = 0; i < DCACHE_SIZE; ++i) {
+		dc->dentries[i].dir_block = TBA;
 	}
-	// Need another update
-	else {
-		first_free_occurrency->indirect->file_blocks[first_free_occurrency->pos_in_node] = voyager;
-		++first_free_occurrency->indirect->num_entries;
-		snorlax = DiskDriver_writeBlock(disk, first_free_occurrency->indirect, first_free_occurrency->indirect->header.block_in_disk);
-		if (snorlax == TBA) {
-			printf ("ERROR UPDATING DCB ON THE DISK @ iNodeFS_createFile()\n");
-			
-			return NULL;
-		}		
+	for (int i = 0; i < PCACHE_SIZE; ++i) {
+		dc->prefixes[i].block_in_disk = TBA;
 	}
-	d->dcb->num_entries += 1;
-	snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-	if (snorlax == TBA) {
-		printf ("ERROR UPDATING DCB ON THE DISK @ iNodeFS_createFile()\n");
-		return NULL;
+	dc->generation = 0;
+	dc->hits = 0;
+	dc->misses = 0;
+	dc->prefix_hits = 0;
+}
+
+// returns the slot of the dentry cache for the name with the given hash, searched in dir_block
+int AUX_dcache_slot(int dir_block, uint32_t hash, int node_type) {
+	uint32_t key = hash ^ ((uint32_t) dir_block * 2654435761u) ^ (uint32_t) (node_type + 1);
+	return (int) (key % DCACHE_SIZE);
+}
+
+// as AUX_dir_lookup, but the result is first searched in (and then stored in) the dentry cache of fs
+// negative results are cached too
+int AUX_cached_lookup(iNodeFS* fs, iNode* dir, const char* name, int node_type, int* entry_block, int* entry_offset) {
+	
+	DentryCache* dc = &fs->dcache;
+	uint32_t hash = AUX_name_hash(name);
+	int dir_block = dir->header.block_in_disk;
+	Dentry* dentry = &dc->dentries[AUX_dcache_slot(dir_block, hash, node_type)];
+	
+	// Hit
+	if (dentry->dir_block == dir_block && dentry->index_buckets == dir->index_buckets &&
+			dentry->node_type == node_type && dentry->hash == hash && strcmp(dentry->name, name) == 0) {
+		dc->hits += 1;
+		if (entry_block != NULL) *entry_block = dentry->entry_block;
+		if (entry_offset != NULL) *entry_offset = dentry->entry_offset;
+		return dentry->block_in_disk;
 	}
-	d = daux;
 	
-	// Freeing memory	
-	daux = NULL;
-	free(daux);
-	first_free_occurrency = NULL;
-	free (first_free_occurrency);
+	// Miss: searching on the disk and replacing the dentry in the slot
+	dc->misses += 1;
+	int block = TBA;
+	int offset = TBA;
+	int ret = AUX_dir_lookup(fs->disk, dir, name, node_type, &block, &offset);
+	if (strlen(name) < NAME_SIZE) {
+		dentry->dir_block = dir_block;
+		dentry->index_buckets = dir->index_buckets;
+		dentry->node_type = node_type;
+		dentry->block_in_disk = ret;
+		dentry->entry_block = block;
+		dentry->entry_offset = offset;
+		dentry->hash = hash;
+		strcpy(dentry->name, name);
+	}
+	if (entry_block != NULL) *entry_block = block;
+	if (entry_offset != NULL) *entry_offset = offset;
 	
-	return filehandle;
+	return ret;
 }
 
-// reads in the (preallocated) blocks array, the name of all files in a directory 
-int iNodeFS_readDir(char** names, DirectoryHandle* d) {
+// drops from the dentry cache the dentries of name in the directory dir_block, of any type
+void AUX_dcache_invalidate(DentryCache* dc, int dir_block, const char* name) {
+	uint32_t hash = AUX_name_hash(name);
+	int types[3] = { FIL, DIR, ANY };
+	for (int i = 0; i < 3; ++i) {
+		Dentry* dentry = &dc->dentries[AUX_dcache_slot(dir_block, hash, types[i])];
+		if (dentry->dir_block == dir_block && dentry->hash == hash && strcmp(dentry->name, name) == 0) {
+			dentry->dir_block = TBA;
+		}
+	}
+}
+
+// drops from the dentry cache all the dentries of the directory dir_block
+void AUX_dcache_invalidate_dir(DentryCache* dc, int dir_block) {
+	for (int i = 0; i < DCACHE_SIZE; ++i) {
+		if (dc->dentries[i].dir_block == dir_block) dc->dentries[i].dir_block = TBA;
+	}
+}
+
+// removes from the directory dir the entry at entry_offset in the DirectoryBlock entry_block
+// its space goes to the previous entry of the block
+// updates dir (written back by the iNode cache)
+// returns 0 on success, -1 on error
+int AUX_dir_remove(DiskDriver* disk, iNode* dir, int entry_block, int entry_offset) {
+	
+	DirectoryBlock* aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, entry_block, BLOCK_WRITE);
+	if (aux_db == NULL) {
+		printf ("ERROR READING @ AUX_dir_remove()\n");
+		return TBA;
+	}
 	
-	// Preliminary stuffs
-	if (d == NULL) return TBA;
-	if (d->infs == NULL) return TBA;
-	DiskDriver* disk = d->infs->disk;
-	if (d == NULL) return TBA;
+	// Looking for the previous entry
+	DirectoryEntry* prev = NULL;
+	DirectoryEntry* entry = NULL;
+	for (int offset = 0; offset < entry_offset; offset += entry->rec_len) {
+		entry = (DirectoryEntry*) (aux_db->entries + offset);
+		if (entry->rec_len == 0) break;
+		prev = entry;
+	}
 	
-	// Creating an iNode struct to store what I need
-	iNode* aux_node = (iNode*) malloc(sizeof(iNode));
-	int snorlax = TBA;
+	entry = (DirectoryEntry*) (aux_db->entries + entry_offset);
+	if (prev != NULL) prev->rec_len += entry->rec_len;
+	else entry->block_in_disk = TBA;
+	DiskDriver_releaseBlock(disk, aux_db);
 	
-	// Search in the inode
-	// if snorlax == TBA, the block is free according to the bitmap
-	// else check the node name
-	// j is the index that refers to names array
-	int j = 0;
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (d->dcb->file_blocks[i] != TBA) {
-			snorlax = DiskDriver_readBlock(disk, aux_node, d->dcb->file_blocks[i]);
-			if (snorlax != TBA) {
-				strcpy(names[j], aux_node->fcb.name);
-				++j;
-			}
-		}				
-	}
+	// Updating dir
+	dir->num_entries -= 1;
+	AUX_idirty(dir);
 	
-	// Single Indirect
-	if (d->dcb->single_indirect != TBA) {
-		iNode_indirect* single_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, single_indirect, d->dcb->single_indirect);
-		if (snorlax == TBA) {
-			printf ("ERROR READING @ iNodeFS_readDir()\n");
-			
-			// Freeing Memoy
-			aux_node = NULL;
-			free (aux_node);
-			single_indirect = NULL;
-			free (single_indirect);
-			return TBA;
+	return 0;
+}
+
+// frees the runs mapped by the num records recs of an extent tree's node of the given depth,
+// and the ExtentNodes under it
+// returns 0 on success, -1 on error
+int AUX_extent_free(DiskDriver* disk, Extent* recs, int num, int depth) {
+	
+	int ret = 0;
+	for (int i = 0; i < num; ++i) {
+		
+		// A leaf: freeing the run
+		if (depth == 0) {
+			if (DiskDriver_freeExtent(disk, recs[i].block_in_disk, recs[i].len) == TBA) ret = TBA;
+			continue;
 		}
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (single_indirect->file_blocks[i] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_node, single_indirect->file_blocks[i]);
-				if (snorlax != TBA) {
-					strcpy(names[j], aux_node->fcb.name);
-					++j;
-				}
-			}
+		
+		// An index record: freeing the subtree and then its node
+		ExtentNode* aux_node = (ExtentNode*) DiskDriver_getBlockPtr(disk, recs[i].block_in_disk, BLOCK_READ);
+		if (aux_node == NULL) {
+			ret = TBA;
+			continue;
 		}
+		if (AUX_extent_free(disk, aux_node->extents, aux_node->num_extents, aux_node->depth) == TBA) ret = TBA;
+		DiskDriver_releaseBlock(disk, aux_node);
+		if (DiskDriver_freeBlock(disk, recs[i].block_in_disk) == TBA) ret = TBA;
+	}
+	
+	return ret;
+}
+
+// frees all the blocks of node (FileBlocks or DirectoryBlocks) and its ExtentNodes
+// the node itself is not freed: it's left with no extents and no blocks
+// returns 0 on success, -1 on error
+int AUX_free_node_blocks(DiskDriver* disk, iNode* node) {
+	
+	// Inline data takes no blocks
+	if (node->depth == INLINE) {
+		memset(AUX_inline_data(node), 0, INODE_INLINE_SIZE);
+		return 0;
+	}
+	
+	int ret = AUX_extent_free(disk, node->extents, node->num_extents, node->depth);
+	node->num_extents = 0;
+	node->depth = 0;
+	node->fcb.size_in_blocks = 0;
+	node->fcb.size_in_bytes = 0;
+	
+	return ret;
+}
+
+// creates an empty file in the directory d
+// returns null on error (file existing, no free blocks)
+// an empty file consists only of a iNode block of type FIL
+FileHandle* iNodeFS_createFile(DirectoryHandle* d, const char* filename) {
+	
+	// Preliminary stuffs
+	if (d == NULL) return NULL;
+	if (d->infs == NULL) return NULL;
+	DiskDriver* disk = d->infs->disk;
+	if (disk == NULL) return NULL;
+	if (strlen(filename) >= NAME_SIZE) {
+		printf ("NAME %s TOO LONG. CREATION FAILED @ iNodeFS_createFile()\n", filename);
+		return NULL;
+	}
+	
+	// Searching for an already existent file
+	int snorlax = AUX_cached_lookup(d->infs, d->dcb, filename, FIL, NULL, NULL);
+	if (snorlax != TBA) {
+		printf ("FILE %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_createFile()\n", filename);
+		return NULL;
+	}
+	
+	// Creation time. The file goes near its directory, in the same allocation group
+	int voyager = AUX_inode_alloc(d->infs, d->dcb->header.block_in_disk);
+	if (voyager == TBA) {
+		printf ("ERROR - INODE TABLE COULD BE FULL @ iNodeFS_createFile()\n");
+		return NULL;
+	}
+	iNode* aux_node = (iNode*) AUX_scratch_get(d->infs);
+	memset(aux_node, 0, disk->block_size);
+	
+	// Header creation
+	BlockHeader header;
+	header.block_in_file = TBA;
+	header.block_in_node = TBA;
+	header.block_in_disk = voyager;
+	
+	// iNode Control Block creation
+	iNodeControlBlock icb;
+	icb.directory_block = d->dcb->header.block_in_disk;
+	icb.block_in_disk = voyager;
+	icb.upper = TBA;
+	icb.node_type = FIL;
+	
+	// File Control Block creation
+	FileControlBlock fcb;
+	memset(&fcb, 0, sizeof(FileControlBlock));
+	fcb.size_in_bytes = 0;
+	fcb.size_in_blocks = 0;
+	fcb.icb = icb;
+	
+	// Compacting all
+	aux_node->header = header;
+	aux_node->fcb = fcb;
+	aux_node->num_entries = 0;
+	aux_node->depth = (INLINE_DATA) ? INLINE : 0;		// the data stays in the iNode while it fits
+	aux_node->num_extents = 0;
+	aux_node->index_buckets = 0;
+	
+	// Writing on the disk
+	snorlax = AUX_inode_write(d->infs, aux_node);
+	if (snorlax == TBA) {
+		printf ("ERROR WRITING AUX NODE ON THE DISK @ iNodeFS_createFile()\n");
+		
 		// Freeing memory
-		single_indirect = NULL;
-		free (single_indirect);
+		AUX_scratch_put(d->infs, aux_node);
+		return NULL;
+	}
+	
+	// Updating the directory
+	snorlax = AUX_dir_add(d->infs, d->dcb, filename, FIL, voyager);
+	AUX_dcache_invalidate(&d->infs->dcache, d->dcb->header.block_in_disk, filename);
+	AUX_scratch_put(d->infs, aux_node);
+	if (snorlax == TBA) {
+		printf ("ERROR UPDATING DCB ON THE DISK @ iNodeFS_createFile()\n");
+		
+		// Freeing memory
+		AUX_inode_free(d->infs, voyager);
+		return NULL;
+	}
+	
+	// The handle uses the cached copy of the node
+	aux_node = AUX_iget(d->infs, voyager);
+	if (aux_node == NULL) {
+		printf ("ERROR READING @ iNodeFS_createFile()\n");
+		return NULL;
 	}
 	
-	// Double Indirect
-	if (d->dcb->double_indirect != TBA) {
-		iNode_indirect* double_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, double_indirect, d->dcb->double_indirect);
-		if (snorlax == TBA) {
+	// Creating the filehandle
+	FileHandle* filehandle = AUX_handle_get(d->infs);
+	filehandle->infs = d->infs;
+	filehandle->fcb = aux_node;
+	filehandle->directory = d->dcb;
+	AUX_iref(d->dcb);
+	filehandle->pos_in_file = 0;
+	
+	return filehandle;
+}
+
+// reads in the (preallocated) blocks array, the name of all files in a directory 
+int iNodeFS_readDir(char** names, DirectoryHandle* d) {
+	
+	// Preliminary stuffs
+	if (d == NULL) return TBA;
+	if (d->infs == NULL) return TBA;
+	DiskDriver* disk = d->infs->disk;
+	if (disk == NULL) return TBA;
+	
+	// The DirectoryBlocks are read in place in the map
+	DirectoryBlock* aux_db = NULL;
+	DirectoryEntry* entry = NULL;
+	int voyager = TBA;
+	
+	// j is the index that refers to names array
+	int j = 0;
+	for (int i = 0; ; ++i) {
+		voyager = AUX_file_block(disk, d->dcb, i, TBA, READ);
+		if (voyager == TBA) break;
+		aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_READ);
+		if (aux_db == NULL) {
 			printf ("ERROR READING @ iNodeFS_readDir()\n");
-			
-			// Freeing memory
-			aux_node = NULL;
-			free (aux_node);
-			double_indirect = NULL;
-			free (double_indirect);
 			return TBA;
 		}
-		iNode_indirect* nod = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (double_indirect->file_blocks[i] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, nod, double_indirect->file_blocks[i]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_readDir()\n");
-			
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);
-					double_indirect = NULL;
-					free (double_indirect);
-					nod = NULL;
-					free (nod);
-					return TBA;
-				}
-				for (int k = 0; k < indirect_idx_size; ++k) {
-					if (nod->file_blocks[k] != TBA) {
-						snorlax = DiskDriver_readBlock(disk, aux_node, nod->file_blocks[k]);
-						if (snorlax != TBA) {
-							strcpy(names[j], aux_node->fcb.name);
-							++j;
-						}
-					}
-				}
+		for (int offset = 0; offset < DB_ENTRIES_SIZE(disk); offset += entry->rec_len) {
+			entry = (DirectoryEntry*) (aux_db->entries + offset);
+			if (entry->rec_len == 0) break;
+			if (entry->block_in_disk != TBA) {
+				memcpy(names[j], entry->name, entry->name_len);
+				names[j][entry->name_len] = '\0';
+				++j;
 			}
 		}
-		// Freeing memory
-		nod = NULL;
-		free (nod);
-		double_indirect = NULL;
-		free (double_indirect);	
+		DiskDriver_releaseBlock(disk, aux_db);
 	}
 	
-	// Freeing memory
-	aux_node = NULL;
-	free (aux_node);
 	return j;
 }
 
@@ -963,583 +1093,866 @@ FileHandle* iNodeFS_openFile(DirectoryHandle* d, const char* filename) {
 	if (d == NULL) return NULL;
 	if (d->infs == NULL) return NULL;
 	DiskDriver* disk = d->infs->disk;
-	if (d == NULL) return NULL;
+	if (disk == NULL) return NULL;
 	
-	// Creating an iNode struct to store what I need
-	iNode* aux_node = (iNode*) malloc(sizeof(iNode));
-	int snorlax = TBA;
+	// Searching the file in the directory
+	int voyager = AUX_cached_lookup(d->infs, d->dcb, filename, FIL, NULL, NULL);
+	if (voyager == TBA) {
+		printf ("FILE %s DOES NOT EXISTS\n", filename);
+		return NULL;
+	}
+	
+	// Getting its iNode from the cache
+	iNode* aux_node = AUX_iget(d->infs, voyager);
+	if (aux_node == NULL) {
+		printf ("ERROR READING @ iNodeFS_openFile()\n");
+		return NULL;
+	}
 	
 	// Creating the filhandle
-	FileHandle* filehandle = (FileHandle*) malloc(sizeof(FileHandle));
+	FileHandle* filehandle = AUX_handle_get(d->infs);
 	filehandle->infs = d->infs;
-	filehandle->fcb = NULL;
+	filehandle->fcb = aux_node;
 	filehandle->directory = d->dcb;
-	filehandle->indirect = NULL;
-	filehandle->current_block = NULL;
-	filehandle->pos_in_node = 0;
-	filehandle->pos_in_block = 0;
-	
-	// Search in the inode
-	// if snorlax == TBA, the block is free according to the bitmap
-	// else check the node name
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (d->dcb->file_blocks[i] != TBA) {
-			snorlax = DiskDriver_readBlock(disk, aux_node, d->dcb->file_blocks[i]);
-			if (snorlax != TBA) {
-				if (strcmp(aux_node->fcb.name, filename) == 0 && aux_node->fcb.icb.node_type == FIL) {
-					filehandle->fcb = aux_node;
-					filehandle->current_block = &(aux_node->header);
-					
-					return filehandle;
-				}
-			}
-		}					
-	}
+	AUX_iref(d->dcb);
+	filehandle->pos_in_file = 0;
 	
-	// Single Indirect
-	if (d->dcb->single_indirect != TBA) {
-		iNode_indirect* single_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, single_indirect, d->dcb->single_indirect);
-		if (snorlax == TBA) {
-			printf ("ERROR READING @ iNodeFS_openFile()\n");
-			
-			// Freeing Memoy
-			filehandle = NULL;
-			free (filehandle);
-			aux_node = NULL;
-			free (aux_node);
-			single_indirect = NULL;
-			free (single_indirect);
-			return NULL;
+	return filehandle;
+}
+
+// closes a file handle (destroyes it)
+// RETURNS 0 on success, -1 if fails
+int iNodeFS_close(FileHandle* f) {
+	
+	// Preliminary stuffs
+	if (f == NULL) return TBA;
+	if (f->infs == NULL) return TBA;
+	if (f->infs->disk == NULL) return TBA;
+	
+	// Giving back the iNodes
+	int ret = AUX_iput(f->infs, f->fcb);
+	AUX_iput(f->infs, f->directory);
+	
+	// Closing
+	AUX_handle_put(f->infs, f);
+	
+	return ret;
+}
+
+
+// writes in the file fcb, from offset on, size bytes stored in data, allocating the missing
+// blocks in runs as long as the disk allows. Inline data is written in the iNode while it fits,
+// else it's moved out first. If offset is past the end of the file the gap
+// is filled with zeros. written is set to the bytes written, even when the disk gets full
+// returns 0 on success, -1 on error
+int AUX_file_write(iNodeFS* fs, iNode* fcb, void* data, int64_t size, int64_t offset, int64_t* written) {
+	
+	DiskDriver* disk = fs->disk;
+	*written = 0;
+	if (size <= 0) return 0;
+	
+	// Blocks stuffs
+	// A run of blocks contiguous on the disk is modified in place in the map, with a single copy
+	char* aux_fb = NULL;
+	int voyager = TBA;
+	int run = 0;
+	int fresh = 0;
+	int block_in_file = 0;
+	int pos_in_block = 0;
+	int last_block = 0;
+	int ret = 0;
+	
+	// Starting from the end of the file if offset is past it, so that the file has no holes
+	int64_t end = offset + size;
+	int64_t pos = (offset < fcb->num_entries) ? offset : fcb->num_entries;
+	int64_t run_start = 0;
+	int64_t run_end = 0;
+	int64_t stop = 0;
+	int64_t from = 0;
+	
+	// Inline data: the file is written in its iNode, unless it grows too large for it
+	if (fcb->depth == INLINE) {
+		if (end <= INODE_INLINE_SIZE) {
+			char* inline_data = AUX_inline_data(fcb);
+			if (offset > fcb->num_entries) memset(inline_data + fcb->num_entries, 0, offset - fcb->num_entries);
+			memcpy(inline_data + offset, data, size);
+			*written = size;
+			if (end > fcb->num_entries) fcb->num_entries = end;
+			if (end > fcb->valid_bytes) fcb->valid_bytes = end;
+			AUX_idirty(fcb);
+			return 0;
 		}
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (single_indirect->file_blocks[i] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_node, single_indirect->file_blocks[i]);
-				if (snorlax != TBA) {
-					if (strcmp(aux_node->fcb.name, filename) == 0 && aux_node->fcb.icb.node_type == FIL){
-						filehandle->fcb = aux_node;
-						filehandle->current_block = &(aux_node->header);
-						
-						// Freeing memory
-						single_indirect = NULL;
-						free (single_indirect);
-						
-						return filehandle;
-					}
-				}
+		if (AUX_inline_move_out(fs, fcb) == TBA) return TBA;
+		AUX_idirty(fcb);
+	}
+	
+	// The blocks after the valid bytes can hold old data (they were preallocated): the ones before offset are cleared
+	if (offset > fcb->valid_bytes && AUX_file_zero(disk, fcb, fcb->valid_bytes, offset) == TBA) return TBA;
+	AUX_locate(disk, end - 1, &last_block, &pos_in_block);
+	
+	// New runs are placed right after the block before them, to keep the file contiguous
+	AUX_locate(disk, pos, &block_in_file, &pos_in_block);
+	int hint = (block_in_file > 0) ? AUX_extent_lookup(disk, fcb, block_in_file - 1, NULL) : TBA;
+	hint = (hint != TBA) ? hint + 1 : AUX_node_hint(fs, fcb);
+	
+	while (pos < end) {
+		AUX_locate(disk, pos, &block_in_file, &pos_in_block);
+		voyager = AUX_extent_lookup(disk, fcb, block_in_file, &run);
+		if (run > last_block - block_in_file + 1) run = last_block - block_in_file + 1;
+		fresh = (voyager == TBA);
+		
+		// Missing blocks: allocating them as a single run, if the disk has one that long
+		if (fresh) {
+			voyager = DiskDriver_allocExtent(disk, hint, 1, run, &run);
+			if (voyager == TBA || AUX_extent_insert(disk, fcb, block_in_file, voyager, run, voyager + run) == TBA) {
+				if (voyager != TBA) DiskDriver_freeExtent(disk, voyager, run);
+				printf ("ERROR DISK FULL @ AUX_file_write()\n");
+				ret = TBA;
+				break;
 			}
+			fcb->fcb.size_in_blocks += run;
+			fcb->fcb.size_in_bytes += (int64_t) run << disk->block_shift;
 		}
-		// Freeing memory
-		single_indirect = NULL;
-		free (single_indirect);
+		hint = voyager + run;
+		
+		// The bytes of the run we go through: from pos to stop
+		run_start = pos - pos_in_block;
+		run_end = run_start + ((int64_t) run << disk->block_shift);
+		stop = (run_end < end) ? run_end : end;
+		from = (pos > offset) ? pos : offset;
+		
+		aux_fb = (char*) DiskDriver_getExtentPtr(disk, voyager, run, BLOCK_WRITE);
+		if (aux_fb == NULL) {
+			printf ("ERROR WRITING @ AUX_file_write()\n");
+			ret = TBA;
+			break;
+		}
+		
+		// The gap before offset is zeros, and so are the new blocks where they're not written
+		if (fresh) memset(aux_fb, 0, pos - run_start);
+		if (from > pos) memset(aux_fb + (pos - run_start), 0, ((from < stop) ? from : stop) - pos);
+		if (from < stop) memcpy(aux_fb + (from - run_start), (char*)data + (from - offset), stop - from);
+		if (fresh) memset(aux_fb + (stop - run_start), 0, run_end - stop);
+		DiskDriver_releaseBlock(disk, aux_fb);
+		
+		pos = stop;
 	}
 	
-	// Double Indirect
-	if (d->dcb->double_indirect != TBA) {
-		iNode_indirect* double_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, double_indirect, d->dcb->double_indirect);
-		if (snorlax == TBA) {
-			printf ("ERROR READING @ iNodeFS_openFile()\n");
-			
-			// Freeing memory
-			aux_node = NULL;
-			free (aux_node);
-			double_indirect = NULL;
-			free (double_indirect);
-			return NULL;
-		}
-		iNode_indirect* nod = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (double_indirect->file_blocks[i] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, nod, double_indirect->file_blocks[i]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_openFile()\n");
-			
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);
-					double_indirect = NULL;
-					free (double_indirect);
-					nod = NULL;
-					free (nod);
-					return NULL;
-				}
-				for (int j = 0; j < indirect_idx_size; ++j) {
-					if (nod->file_blocks[j] != TBA) {
-						snorlax = DiskDriver_readBlock(disk, aux_node, nod->file_blocks[j]);
-						if (snorlax != TBA) {
-							if (strcmp(aux_node->fcb.name, filename) == 0 && aux_node->fcb.icb.node_type == FIL) {
-								filehandle->fcb = aux_node;
-								filehandle->current_block = &(aux_node->header);
-								
-								// Freeing memory
-								double_indirect = NULL;
-								free (double_indirect);
-								nod = NULL;
-								free (nod);
-								
-								return filehandle;
-							}
-						}
-					}
-				}
+	// Updating the length of the file, if we wrote past its end
+	// The node is written back by the iNode cache
+	if (pos > offset) {
+		*written = pos - offset;
+		if (pos > fcb->num_entries) fcb->num_entries = pos;
+		if (pos > fcb->valid_bytes) fcb->valid_bytes = pos;
+	}
+	AUX_idirty(fcb);
+	
+	return ret;
+}
+
+// clears the bytes of fcb from from to to that are stored in its blocks (the ones not mapped read as zeros anyway)
+// returns 0 on success, -1 on error
+int AUX_file_zero(DiskDriver* disk, iNode* fcb, int64_t from, int64_t to) {
+	
+	// Blocks stuffs
+	// A run of blocks contiguous on the disk is cleared in place in the map at once
+	char* aux_fb = NULL;
+	int voyager = TBA;
+	int run = 0;
+	int block_in_file = 0;
+	int pos_in_block = 0;
+	int last_block = 0;
+	int64_t span = 0;
+	
+	if (from >= to || fcb->depth == INLINE) return 0;
+	AUX_locate(disk, to - 1, &last_block, &pos_in_block);
+	
+	while (from < to) {
+		AUX_locate(disk, from, &block_in_file, &pos_in_block);
+		voyager = AUX_extent_lookup(disk, fcb, block_in_file, &run);
+		if (run > last_block - block_in_file + 1) run = last_block - block_in_file + 1;
+		span = ((int64_t) run << disk->block_shift) - pos_in_block;
+		if (span > to - from) span = to - from;
+		
+		if (voyager != TBA) {
+			aux_fb = (char*) DiskDriver_getExtentPtr(disk, voyager, run, BLOCK_WRITE);
+			if (aux_fb == NULL) {
+				printf ("ERROR WRITING @ AUX_file_zero()\n");
+				return TBA;
 			}
+			memset(aux_fb + pos_in_block, 0, span);
+			DiskDriver_releaseBlock(disk, aux_fb);
 		}
-		// Freeing memory
-		double_indirect = NULL;
-		free (double_indirect);
-		nod = NULL;
-		free (nod);
-		return NULL;
+		from += span;
 	}
 	
+	return 0;
+}
+
+// writes in the file fcb, from offset on, size bytes stored in data, keeping them in its write-back buffer:
+// the blocks are allocated when the buffer is placed on the disk, all the buffered range at once.
+// The buffer is placed on the disk first if the write does not continue it or does not fit in it.
+// Inline data and writes larger than the buffer go straight to AUX_file_write.
+// written is set to the bytes written. A removed file is not written
+// returns 0 on success, -1 on error
+int AUX_wb_write(iNodeFS* fs, iNode* fcb, void* data, int64_t size, int64_t offset, int64_t* written) {
+	
+	CachedNode* cached = AUX_cached(fcb);
+	int cap = WB_BLOCKS * fs->disk->block_size;
+	int64_t end = offset + size;
+	*written = 0;
+	if (size <= 0) return 0;
+	if (cached->removed) {
+		printf ("ERROR FILE REMOVED @ AUX_wb_write()\n");
+		return TBA;
+	}
+	if (end > FILE_MAX_BYTES(fs->disk->block_shift)) {
+		printf ("ERROR FILE TOO LONG @ AUX_wb_write()\n");
+		return TBA;
+	}
 	
-	// Freeing memory
-	filehandle = NULL;
-	free (filehandle);
-	aux_node = NULL;
-	free (aux_node);
+	// Inline data has no blocks to allocate. A file growing out of its iNode gets its block now,
+	// so that the data in the iNode is never mixed with the buffered one
+	if (fcb->depth == INLINE) {
+		if (end <= INODE_INLINE_SIZE) return AUX_file_write(fs, fcb, data, size, offset, written);
+		if (AUX_inline_move_out(fs, fcb) == TBA) return TBA;
+		AUX_idirty(fcb);
+	}
 	
-	printf ("FILE %s DOES NOT EXISTS\n", filename);
-	return NULL;
+	// The buffer holds a single range: a write out of it (or making it too long) places it on the disk
+	if (cached->wb_len > 0 && (offset < cached->wb_start || offset > cached->wb_start + cached->wb_len ||
+		end - cached->wb_start > cap)) {
+		if (AUX_wb_flush(fs, fcb) == TBA) return TBA;
+	}
+	if (size > cap) return AUX_file_write(fs, fcb, data, size, offset, written);
+	
+	if (cached->wb_cap < cap) {
+		free(cached->wb_data);
+		cached->wb_data = (char*) malloc(cap);
+		cached->wb_cap = cap;
+	}
+	if (cached->wb_len == 0) {
+		cached->wb_start = offset;
+		cached->wb_size = fcb->num_entries;
+	}
+	
+	// Buffering. The file grows now: what's not placed on the disk yet reads from the buffer
+	memcpy(cached->wb_data + (offset - cached->wb_start), data, size);
+	if (end - cached->wb_start > cached->wb_len) {
+		fs->icache.wb_bytes += end - cached->wb_start - cached->wb_len;
+		cached->wb_len = end - cached->wb_start;
+	}
+	if (end > fcb->num_entries) fcb->num_entries = end;
+	AUX_idirty(fcb);
+	*written = size;
+	
+	// Too much buffered data in the cache: placing all of it on the disk
+	if (fs->icache.wb_bytes > ((int64_t) WB_CACHE_BLOCKS << fs->disk->block_shift)) return AUX_wb_flush_all(fs);
+	return 0;
 }
 
-// closes a file handle (destroyes it)
-// RETURNS 0 on success, -1 if fails
-int iNodeFS_close(FileHandle* f) {
+// places on the disk the write-back buffer of the cached iNode node, allocating its blocks.
+// The buffer of a removed file is dropped
+// returns 0 on success, -1 on error (the file is cut to what was placed on the disk)
+int AUX_wb_flush(iNodeFS* fs, iNode* node) {
+	CachedNode* cached = AUX_cached(node);
+	int len = cached->wb_len;
+	if (len == 0) return 0;
+	cached->wb_len = 0;
+	fs->icache.wb_bytes -= len;
+	if (cached->removed) return 0;
+	
+	int64_t written = 0;
+	int ret = AUX_file_write(fs, node, cached->wb_data, len, cached->wb_start, &written);
+	if (ret == TBA) {
+		int64_t placed = cached->wb_start + written;
+		if (placed < cached->wb_size) placed = cached->wb_size;
+		if (node->num_entries > placed) node->num_entries = placed;
+		AUX_idirty(node);
+		printf ("ERROR PLACING THE WRITE-BACK BUFFER @ AUX_wb_flush()\n");
+	}
+	return ret;
+}
+
+// places on the disk the write-back buffers of all the iNodes in the cache
+// returns 0 on success, -1 on error
+int AUX_wb_flush_all(iNodeFS* fs) {
+	int ret = 0;
+	for (int i = 0; i < ICACHE_BUCKETS && fs->icache.wb_bytes > 0; ++i) {
+		for (CachedNode* cached = fs->icache.buckets[i]; cached != NULL; cached = cached->next) {
+			if (AUX_wb_flush(fs, &cached->node) == TBA) ret = TBA;
+		}
+	}
+	return ret;
+}
+
+// copies over data (size bytes of the file node from offset on) the buffered bytes that fall in it
+void AUX_wb_overlay(iNode* node, char* data, int64_t offset, int64_t size) {
+	CachedNode* cached = AUX_cached(node);
+	if (cached->wb_len == 0) return;
+	int64_t from = (offset > cached->wb_start) ? offset : cached->wb_start;
+	int64_t to = offset + size;
+	if (to > cached->wb_start + cached->wb_len) to = cached->wb_start + cached->wb_len;
+	if (from < to) memcpy(data + (from - offset), cached->wb_data + (from - cached->wb_start), to - from);
+}
+
+// places on the disk the bytes written in the file of f that are still in its write-back buffer
+// returns 0 on success, -1 on error
+int iNodeFS_flush(FileHandle* f) {
+	if (f == NULL || f->infs == NULL || f->fcb == NULL) return TBA;
+	return AUX_wb_flush(f->infs, f->fcb);
+}
+
+// writes in the file, at current position for size bytes stored in data
+// overwriting and allocating new space if necessary (when the write-back buffer is placed on the disk)
+// returns the number of bytes written, -1 on error (or if the file was removed while f was open)
+int64_t iNodeFS_write(FileHandle* f, void* data, int64_t size) {
 	
 	// Preliminary stuffs
 	if (f == NULL) return TBA;
 	if (f->infs == NULL) return TBA;
-	if (f->infs->disk == NULL) return TBA;
+	DiskDriver* disk = f->infs->disk;
+	if (disk == NULL) return TBA;
+	if (data == NULL) return TBA;
 	
-	// Closing
-	f = NULL;
-	free (f);
+	// Writing and moving the cursor after what was written
+	int64_t written_data = 0;
+	int snorlax = AUX_wb_write(f->infs, f->fcb, data, size, f->pos_in_file, &written_data);
+	f->pos_in_file += written_data;
 	
-	return 0;
+	if (snorlax == TBA) return TBA;
+	return written_data;
 }
 
-
-// puts the filehandle at the right place in the inode with side effect on the filehandle
-// mode == READ or WRITE
-void AUX_indirect_management (FileHandle* f, int mode) {
+// reads in the file, at current position size bytes and stores them in data
+// returns the number of bytes read: less than size only at the end of the file
+int64_t iNodeFS_read(FileHandle* f, void* data, int64_t size) {
 	
-	if (f == NULL) return;
+	// Preliminary stuffs
+	if (f == NULL) return TBA;
+	if (f->infs == NULL) return TBA;
 	DiskDriver* disk = f->infs->disk;
-	int snorlax = TBA;
-	iNode_indirect* aux_node = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-	
-	// Case 1 : we're in the main node (type FIL), so f->indirect == NULL;
-	// if there's need to create an indirect node, create it, write it and locate the filehandle
-	if (f->indirect == NULL) {
-		// There's space in FIL
-		if (f->pos_in_node < inode_idx_size) return;
-		// Need to create indirect node
-		if (f->fcb->single_indirect == TBA && mode == WRITE) {
+	if (disk == NULL) return TBA;
+	if (data == NULL) return TBA;
+	
+	// Reading and moving the cursor after what was read
+	int64_t read_data = iNodeFS_pread(f, data, size, f->pos_in_file);
+	if (read_data == TBA) return TBA;
+	f->pos_in_file += read_data;
+	
+	return read_data;
+}
+
+// returns the number of bytes read (moving the current pointer to pos)
+// returns pos on success
+// -1 on error (file too short)
+int64_t iNodeFS_seek(FileHandle* f, int64_t pos) {
+	
+	// Preliminary stuffs
+	if (f == NULL) return TBA;
+	if (f->infs == NULL) return TBA;
+	if (f->infs->disk == NULL) return TBA;
+	if (pos < 0) {
+		printf ("ERROR NEGATIVE SEEK INPUT @ iNodeFS_seek()\n");
+		return TBA;
+	}
+	if (pos > f->fcb->num_entries) {
+		printf ("ERROR BAD SEEK INPUT @ iNodeFS_seek()\n");
+		return TBA;
+	}
+	
+	// Updating f
+	f->pos_in_file = pos;
+	
+	return pos;
+}
+
+// returns the inline data of node (a FIL whose depth is INLINE): INODE_INLINE_SIZE bytes in place of its extents
+char* AUX_inline_data(iNode* node) {
+	return (char*) node->extents;
+}
+
+// moves the inline data of node (a FIL) in a data block of its own, and gives node its extents back
+// node is updated only in memory (the caller writes it)
+// returns 0 on success, -1 if the disk is full
+int AUX_inline_move_out(iNodeFS* fs, iNode* node) {
+	
+	DiskDriver* disk = fs->disk;
+	char* inline_data = AUX_inline_data(node);
+	int len = node->num_entries;
+	
+	// Keeping the data aside, since it's where the extents go
+	char* aux_block = (char*) AUX_scratch_get(fs);
+	memcpy(aux_block, inline_data, len);
+	memset(inline_data, 0, INODE_INLINE_SIZE);
+	node->depth = 0;
+	node->num_extents = 0;
+	
+	// An empty file needs no block
+	if (len > 0) {
+		int voyager = AUX_file_block(disk, node, 0, AUX_node_hint(fs, node), WRITE);
+		char* aux_fb = (voyager != TBA) ? (char*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE) : NULL;
+		if (aux_fb == NULL) {
+			printf ("ERROR DISK FULL @ AUX_inline_move_out()\n");
 			
-			int voyager = DiskDriver_getFreeBlock(disk, 0);
-			if (voyager == TBA) {
-				printf ("ERROR DISK FULL @ AUX_indirect_management()\n");
-				return;
+			// The data goes back in the iNode
+			memcpy(inline_data, aux_block, len);
+			node->depth = INLINE;
+			AUX_scratch_put(fs, aux_block);
+			return TBA;
+		}
+		memcpy(aux_fb, aux_block, len);
+		DiskDriver_releaseBlock(disk, aux_fb);
+	}
+	
+	AUX_scratch_put(fs, aux_block);
+	return 0;
+}
+
+// returns the position of the last record of recs (num sorted records) whose block_in_file
+// is not after block_in_file, -1 if there is none
+int AUX_extent_search(Extent* recs, int num, int block_in_file) {
+	
+	// Binary search
+	int voyager = TBA;
+	int low = 0;
+	int high = num - 1;
+	int mid = 0;
+	while (low <= high) {
+		mid = (low + high) / 2;
+		if (recs[mid].block_in_file <= block_in_file) {
+			voyager = mid;
+			low = mid + 1;
+		}
+		else high = mid - 1;
+	}
+	
+	return voyager;
+}
+
+// returns the block in disk that stores the block_in_file-th block of node (a FIL or a DIR),
+// searching its extent tree. run (if not NULL) is set to the blocks from that one on that
+// are contiguous on the disk too (the rest of its extent)
+// returns -1 if the block is not mapped: run is set to the blocks from that one on that are
+// not mapped either (at most, the next extent could be further)
+int AUX_extent_lookup(DiskDriver* disk, iNode* node, int block_in_file, int* run) {
+	
+	// Going down the tree from the iNode. bound is the first block of the file
+	// that's mapped after the ones the current node covers
+	Extent* recs = node->extents;
+	int num = node->num_extents;
+	int depth = node->depth;
+	int bound = INT_MAX;
+	int voyager = TBA;
+	int i = TBA;
+	ExtentNode* aux_node = NULL;
+	ExtentNode* child = NULL;
+	
+	while (1) {
+		i = AUX_extent_search(recs, num, block_in_file);
+		if (i + 1 < num && recs[i + 1].block_in_file < bound) bound = recs[i + 1].block_in_file;
+		if (i == TBA) break;
+		
+		// A leaf: the block is in the i-th run, or in the hole after it
+		if (depth == 0) {
+			if (block_in_file - recs[i].block_in_file < recs[i].len) {
+				voyager = recs[i].block_in_disk + block_in_file - recs[i].block_in_file;
+				bound = recs[i].block_in_file + recs[i].len;
 			}
-					
-			// Creating BlockHeader
-			BlockHeader header;
-			header.block_in_file = TBA;
-			header.block_in_node = SINGLE;
-			header.block_in_disk = voyager;
-			
-			// Creating icb
-			iNodeControlBlock icb;
-			icb.directory_block = f->directory->header.block_in_disk;
-			icb.block_in_disk = header.block_in_disk;
-			icb.upper = f->fcb->header.block_in_disk;
-			icb.node_type = NOD;
-			
-			// NOD stuffs
-			aux_node->header = header;
-			aux_node->icb = icb;
-			aux_node->num_entries = 0;
-			for (int i = 0; i < indirect_idx_size; ++i) {
-				aux_node->file_blocks[i] = TBA;
+			break;
+		}
+		
+		// An index record: going down in its node
+		child = (ExtentNode*) DiskDriver_getBlockPtr(disk, recs[i].block_in_disk, BLOCK_READ);
+		DiskDriver_releaseBlock(disk, aux_node);
+		aux_node = child;
+		if (aux_node == NULL) {
+			printf ("ERROR READING @ AUX_extent_lookup()\n");
+			break;
+		}
+		recs = aux_node->extents;
+		num = aux_node->num_extents;
+		depth = aux_node->depth;
+	}
+	DiskDriver_releaseBlock(disk, aux_node);
+	
+	if (run != NULL) *run = bound - block_in_file;
+	return voyager;
+}
+
+// creates an empty ExtentNode of the given depth for node (a FIL or a DIR), placing it from hint on
+// node is updated only in memory (the caller writes it)
+// returns the new node, pinned in the map, NULL if the disk is full
+ExtentNode* AUX_extent_node(DiskDriver* disk, iNode* node, int depth, int hint) {
+	int voyager = DiskDriver_allocExtent(disk, hint, 1, 1, NULL);
+	if (voyager == TBA) {
+		printf ("ERROR DISK FULL @ AUX_extent_node()\n");
+		return NULL;
+	}
+	
+	// Creating the node in place
+	ExtentNode* aux_node = (ExtentNode*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE);
+	memset(aux_node, 0, disk->block_size);
+	
+	// Header and icb
+	aux_node->header.block_in_file = TBA;
+	aux_node->header.block_in_node = TBA;
+	aux_node->header.block_in_disk = voyager;
+	aux_node->icb.directory_block = node->fcb.icb.directory_block;
+	aux_node->icb.block_in_disk = voyager;
+	aux_node->icb.upper = node->header.block_in_disk;
+	aux_node->icb.node_type = NOD;
+	
+	// NOD stuffs
+	aux_node->depth = depth;
+	aux_node->num_extents = 0;
+	
+	// Updating node sizes (the caller writes it)
+	node->fcb.size_in_blocks += 1;
+	node->fcb.size_in_bytes += disk->block_size;
+	
+	return aux_node;
+}
+
+// places rec among the num sorted records recs of a node of the given depth, that has room for max.
+// If the node is full it's split: its upper half goes in a new ExtentNode, placed from hint on,
+// whose index record is stored in split
+// returns 0 on success, 1 if the node was split, -1 if the disk is full
+int AUX_extent_put(DiskDriver* disk, iNode* node, Extent* recs, int* num, int max, int depth, Extent rec, int hint, Extent* split) {
+	
+	ExtentNode* right = NULL;
+	if (*num == max) {
+		right = AUX_extent_node(disk, node, depth, hint);
+		if (right == NULL) return TBA;
+		right->num_extents = *num / 2;
+		*num -= right->num_extents;
+		memcpy(right->extents, recs + *num, right->num_extents * sizeof(Extent));
+		split->block_in_file = right->extents[0].block_in_file;
+		split->block_in_disk = right->header.block_in_disk;
+		split->len = 0;
+		
+		// rec goes in the half that covers it
+		if (rec.block_in_file >= split->block_in_file) {
+			recs = right->extents;
+			num = &right->num_extents;
+		}
+	}
+	
+	// Making room for rec
+	int i = AUX_extent_search(recs, *num, rec.block_in_file) + 1;
+	memmove(recs + i + 1, recs + i, (*num - i) * sizeof(Extent));
+	recs[i] = rec;
+	++(*num);
+	
+	if (right == NULL) return 0;
+	DiskDriver_releaseBlock(disk, right);
+	return 1;
+}
+
+// adds the run rec to the subtree of the num sorted records recs of a node of the given depth,
+// that has room for max. rec is merged with the runs next to it when it continues them
+// returns 0 on success, 1 if the node was split (split is the index record of its new sibling),
+// -1 if the disk is full
+int AUX_extent_add(DiskDriver* disk, iNode* node, Extent* recs, int* num, int max, int depth, Extent rec, int hint, Extent* split) {
+	
+	int i = AUX_extent_search(recs, *num, rec.block_in_file);
+	
+	// An index node: adding rec in the subtree that covers it (the first one if rec is before all of them)
+	if (depth > 0) {
+		if (i == TBA) {
+			i = 0;
+			recs[0].block_in_file = rec.block_in_file;
+		}
+		ExtentNode* aux_node = (ExtentNode*) DiskDriver_getBlockPtr(disk, recs[i].block_in_disk, BLOCK_WRITE);
+		if (aux_node == NULL) {
+			printf ("ERROR READING @ AUX_extent_add()\n");
+			return TBA;
+		}
+		Extent child_split;
+		int snorlax = AUX_extent_add(disk, node, aux_node->extents, &aux_node->num_extents, NODE_EXT_SIZE(disk), aux_node->depth, rec, hint, &child_split);
+		DiskDriver_releaseBlock(disk, aux_node);
+		
+		// The child was split: its new sibling goes right after it
+		if (snorlax != 1) return snorlax;
+		return AUX_extent_put(disk, node, recs, num, max, depth, child_split, hint, split);
+	}
+	
+	// A leaf: merging rec with the run before it and the one after it, if they're contiguous on the disk too
+	Extent* prev = (i != TBA) ? recs + i : NULL;
+	Extent* next = (i + 1 < *num) ? recs + i + 1 : NULL;
+	int after_prev = (prev != NULL && prev->block_in_file + prev->len == rec.block_in_file &&
+			prev->block_in_disk + prev->len == rec.block_in_disk);
+	int before_next = (next != NULL && rec.block_in_file + rec.len == next->block_in_file &&
+			rec.block_in_disk + rec.len == next->block_in_disk);
+	
+	if (after_prev) {
+		prev->len += rec.len;
+		if (before_next) {
+			prev->len += next->len;
+			memmove(next, next + 1, (*num - i - 2) * sizeof(Extent));
+			--(*num);
+		}
+		return 0;
+	}
+	if (before_next) {
+		next->block_in_file = rec.block_in_file;
+		next->block_in_disk = rec.block_in_disk;
+		next->len += rec.len;
+		return 0;
+	}
+	
+	// A run of its own
+	return AUX_extent_put(disk, node, recs, num, max, depth, rec, hint, split);
+}
+
+// makes room for a record in the iNode node before a change that could split its children:
+// if it's full its records go down in a new ExtentNode, placed from hint on, and the tree grows by a level
+// returns 0 on success, -1 if the disk is full
+int AUX_extent_grow(DiskDriver* disk, iNode* node, int hint) {
+	
+	// A split takes at most a new node for each level, and one more if the tree grows:
+	// checking it first, so that a split is never left half done
+	if (disk->header->free_blocks < node->depth + 1) {
+		printf ("ERROR DISK FULL @ AUX_extent_grow()\n");
+		return TBA;
+	}
+	
+	// A full iNode: its records go down in a new node, and the tree grows by a level
+	if (node->num_extents == INODE_EXT_SIZE) {
+		ExtentNode* aux_node = AUX_extent_node(disk, node, node->depth, hint);
+		if (aux_node == NULL) return TBA;
+		memcpy(aux_node->extents, node->extents, node->num_extents * sizeof(Extent));
+		aux_node->num_extents = node->num_extents;
+		
+		node->extents[0].block_in_file = aux_node->extents[0].block_in_file;
+		node->extents[0].block_in_disk = aux_node->header.block_in_disk;
+		node->extents[0].len = 0;
+		node->num_extents = 1;
+		node->depth += 1;
+		DiskDriver_releaseBlock(disk, aux_node);
+	}
+	
+	return 0;
+}
+
+// maps the len blocks of node from block_in_file on (not mapped yet) to the ones of the disk
+// from block_in_disk on. The run is merged with the extents next to it when it continues them,
+// and the full ExtentNodes are split (or the tree grows by a level), placing the new ones from hint on
+// node is updated only in memory (the caller writes it)
+// returns 0 on success, -1 if the disk is full
+int AUX_extent_insert(DiskDriver* disk, iNode* node, int block_in_file, int block_in_disk, int len, int hint) {
+	
+	if (AUX_extent_grow(disk, node, hint) == TBA) return TBA;
+	
+	// The iNode has room for the split of its children
+	Extent rec = {block_in_file, block_in_disk, len};
+	Extent split;
+	if (AUX_extent_add(disk, node, node->extents, &node->num_extents, INODE_EXT_SIZE, node->depth, rec, hint, &split) == TBA) {
+		return TBA;
+	}
+	
+	return 0;
+}
+
+// unmaps and frees the blocks from from to to (excluded) in the subtree of the num sorted records recs
+// of a node of the given depth, that has room for max. The ExtentNodes left empty are freed.
+// A run cut in the middle keeps its head and gets a new record for its tail, so the node can be split
+// returns 0 on success, 1 if the node was split (split is the index record of its new sibling), -1 on error
+int AUX_extent_cut(DiskDriver* disk, iNode* node, Extent* recs, int* num, int max, int depth, int from, int to, int hint, Extent* split) {
+	
+	// The first record that can cover from
+	int i = AUX_extent_search(recs, *num, from);
+	if (i == TBA) i = 0;
+	
+	// An index node: cutting the subtrees that cover the range
+	if (depth > 0) {
+		while (i < *num && recs[i].block_in_file < to) {
+			ExtentNode* aux_node = (ExtentNode*) DiskDriver_getBlockPtr(disk, recs[i].block_in_disk, BLOCK_WRITE);
+			if (aux_node == NULL) {
+				printf ("ERROR READING @ AUX_extent_cut()\n");
+				return TBA;
 			}
+			Extent child_split;
+			int snorlax = AUX_extent_cut(disk, node, aux_node->extents, &aux_node->num_extents, NODE_EXT_SIZE(disk), aux_node->depth, from, to, hint, &child_split);
+			int empty = (aux_node->num_extents == 0);
+			DiskDriver_releaseBlock(disk, aux_node);
+			if (snorlax == TBA) return TBA;
 			
-			// Writing on the disk
-			snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-			if (snorlax == TBA) {
-				printf ("ERROR WRITING @ AUX_indirect_management()\n");
-						
-				// Freeing memory
-				aux_node = NULL;
-				free (aux_node);
-				return;
-			}
+			// The child was split: the range was inside one of its runs, there's nothing else to cut
+			if (snorlax == 1) return AUX_extent_put(disk, node, recs, num, max, depth, child_split, hint, split);
 			
-			// Updating f->fcb
-			f->fcb->single_indirect = aux_node->header.block_in_disk;
-			f->fcb->fcb.size_in_blocks += 1;
-			f->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-			snorlax = DiskDriver_writeBlock(disk, f->fcb, f->fcb->header.block_in_disk);
-			if (snorlax == TBA) {
-				printf ("ERROR WRITING @ AUX_indirect_management()\n");
-						
-				// Freeing memory
-				aux_node = NULL;
-				free (aux_node);
-				return;
+			// The child is left empty: freeing it
+			if (empty) {
+				DiskDriver_freeBlock(disk, recs[i].block_in_disk);
+				node->fcb.size_in_blocks -= 1;
+				node->fcb.size_in_bytes -= disk->block_size;
+				memmove(recs + i, recs + i + 1, (*num - i - 1) * sizeof(Extent));
+				--(*num);
 			}
-			
-			// Updating f
-			f->indirect = aux_node;
-			f->current_block = &(aux_node->header);
-			f->pos_in_node = 0;
-			f->pos_in_block = 0;
+			else ++i;
 		}
-		// Don't need to create indirect node: it already exists
-		// just update f
-		else {
-			// Updating f
-			snorlax = DiskDriver_readBlock(disk, aux_node, f->fcb->single_indirect);
-			if (snorlax == TBA) {
-				printf ("ERROR READING @ AUX_indirect_management()\n");
-						
-				// Freeing memory
-				aux_node = NULL;
-				free (aux_node);
-				return;
-			}
-			f->indirect = aux_node;
-			f->current_block = &(aux_node->header);
-			f->pos_in_node = 0;
-			f->pos_in_block = 0;
+		return 0;
+	}
+	
+	// A leaf: freeing the part of each run that falls in the range
+	while (i < *num && recs[i].block_in_file < to) {
+		Extent* rec = recs + i;
+		int start = (rec->block_in_file > from) ? rec->block_in_file : from;
+		int end = (rec->block_in_file + rec->len < to) ? rec->block_in_file + rec->len : to;
+		if (start >= end) {
+			++i;
+			continue;
+		}
+		if (DiskDriver_freeExtent(disk, rec->block_in_disk + (start - rec->block_in_file), end - start) == TBA) return TBA;
+		node->fcb.size_in_blocks -= end - start;
+		node->fcb.size_in_bytes -= (int64_t) (end - start) << disk->block_shift;
+		
+		// All the run
+		if (start == rec->block_in_file && end == rec->block_in_file + rec->len) {
+			memmove(rec, rec + 1, (*num - i - 1) * sizeof(Extent));
+			--(*num);
+		}
+		
+		// Its head
+		else if (start == rec->block_in_file) {
+			rec->block_in_disk += end - rec->block_in_file;
+			rec->len -= end - rec->block_in_file;
+			rec->block_in_file = end;
+			++i;
 		}
 		
+		// Its tail
+		else if (end == rec->block_in_file + rec->len) {
+			rec->len = start - rec->block_in_file;
+			++i;
+		}
+		
+		// Its middle: the tail becomes a run of its own
+		else {
+			Extent tail = {end, rec->block_in_disk + (end - rec->block_in_file), rec->block_in_file + rec->len - end};
+			rec->len = start - rec->block_in_file;
+			return AUX_extent_put(disk, node, recs, num, max, depth, tail, hint, split);
+		}
 	}
-	else {
-		// We are in the single indirect
-		if (f->indirect->header.block_in_disk == f->fcb->single_indirect && 
-			f->indirect->icb.upper == f->fcb->header.block_in_disk) {
-			
-			if (f->pos_in_node < indirect_idx_size) return;
-			else {
-				// double indirect also exists: just move there f
-				if (f->fcb->double_indirect != TBA) {
-					// Updating f
-					snorlax = DiskDriver_readBlock(disk, aux_node, f->fcb->double_indirect);
-					if (snorlax == TBA) {
-						printf ("ERROR READING @ AUX_indirect_management()\n");
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					f->indirect = aux_node;
-					f->current_block = &(aux_node->header);
-					f->pos_in_node = 0;
-					f->pos_in_block = 0;
-				}
-				// double indirect does not exists: create it and move there f
-				else if (f->fcb->double_indirect == TBA && mode == WRITE) {
-					memset(aux_node, 0, BLOCK_SIZE);
-					int voyager = DiskDriver_getFreeBlock(disk, 0);
-					if (voyager == TBA) {
-						printf ("ERROR DISK FULL @ AUX_indirect_management()\n");
-						return;
-					}
-					
-					// Creating BlockHeader
-					BlockHeader header;
-					header.block_in_file = TBA;
-					header.block_in_node = DOUBLE;
-					header.block_in_disk = voyager;
-					
-					// Creating icb
-					iNodeControlBlock icb;
-					icb.directory_block = f->directory->header.block_in_disk;
-					icb.block_in_disk = header.block_in_disk;
-					icb.upper = f->fcb->header.block_in_disk;
-					icb.node_type = NOD;
-					
-					// NOD stuffs
-					aux_node->header = header;
-					aux_node->icb = icb;
-					aux_node->num_entries = 0;
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						aux_node->file_blocks[i] = TBA;
-					}
-					
-					// Writing on the disk
-					snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_management()\n");
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating f->fcb
-					f->fcb->double_indirect = aux_node->header.block_in_disk;
-					f->fcb->fcb.size_in_blocks += 1;
-					f->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-					snorlax = DiskDriver_writeBlock(disk, f->fcb, f->fcb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_management()\n");
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating f
-					f->indirect = aux_node;
-					f->current_block = &(aux_node->header);
-					f->pos_in_node = 0;
-					f->pos_in_block = 0;
-					
-				}
-			}
-			
+	
+	return 0;
+}
+
+// unmaps and frees the blocks of node from from to to (excluded), and the ExtentNodes left empty.
+// Then the tree gets lower while the records of the only child of the iNode fit in it
+// node is updated only in memory (the caller writes it)
+// returns 0 on success, -1 on error
+int AUX_extent_remove(DiskDriver* disk, iNode* node, int from, int to, int hint) {
+	
+	if (from >= to || node->depth == INLINE) return 0;
+	
+	// Mapped blocks on both sides of the range: a run could be cut in two, and the tree split as for an insert
+	if (from > 0 && AUX_extent_lookup(disk, node, from - 1, NULL) != TBA && AUX_extent_lookup(disk, node, to, NULL) != TBA) {
+		if (AUX_extent_grow(disk, node, hint) == TBA) return TBA;
+	}
+	
+	Extent split;
+	if (AUX_extent_cut(disk, node, node->extents, &node->num_extents, INODE_EXT_SIZE, node->depth, from, to, hint, &split) == TBA) {
+		return TBA;
+	}
+	if (node->num_extents == 0) node->depth = 0;
+	
+	// Collapsing: an only child whose records fit in the iNode goes up in it
+	while (node->depth > 0 && node->num_extents == 1) {
+		int voyager = node->extents[0].block_in_disk;
+		ExtentNode* aux_node = (ExtentNode*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_READ);
+		if (aux_node == NULL) {
+			printf ("ERROR READING @ AUX_extent_remove()\n");
+			return TBA;
 		}
-		// We are in the double indirect
-		else if (f->indirect->header.block_in_disk == f->fcb->double_indirect && 
-				f->indirect->icb.upper == f->fcb->header.block_in_disk) {
-			
-			if (f->pos_in_node < indirect_idx_size) {
-				// Need to create another NOD, then update f
-				if (f->indirect->file_blocks[f->pos_in_block] == TBA && mode == WRITE) {
-					memset(aux_node, 0, BLOCK_SIZE);
-					int voyager = DiskDriver_getFreeBlock(disk, 0);
-					if (voyager == TBA) {
-						printf ("ERROR DISK FULL @ AUX_indirect_management()\n");
-						return;
-					}
-					
-					// Creating BlockHeader
-					BlockHeader header;
-					header.block_in_file = TBA;
-					header.block_in_node = f->pos_in_node;
-					header.block_in_disk = voyager;
-					
-					// Creating icb
-					iNodeControlBlock icb;
-					icb.directory_block = f->directory->header.block_in_disk;
-					icb.block_in_disk = header.block_in_disk;
-					icb.upper = f->indirect->header.block_in_disk;
-					icb.node_type = NOD;
-					
-					// NOD stuffs
-					aux_node->header = header;
-					aux_node->icb = icb;
-					aux_node->num_entries = 0;
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						aux_node->file_blocks[i] = TBA;
-					}
-					
-					// Writing on the disk
-					snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_management()\n");
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating f->indirect
-					f->indirect->file_blocks[f->pos_in_block] = aux_node->header.block_in_disk;
-					snorlax = DiskDriver_writeBlock(disk, f->indirect, f->indirect->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating f->fcb
-					f->fcb->fcb.size_in_blocks += 1;
-					f->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-					snorlax = DiskDriver_writeBlock(disk, f->fcb, f->fcb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_management()\n");
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating f
-					f->indirect = aux_node;
-					f->current_block = &(aux_node->header);
-					f->pos_in_node = 0;
-					f->pos_in_block = 0;
-				}
-				// double indirect's NOD also exists. Just update f
-				else {
-					snorlax = DiskDriver_readBlock(disk, aux_node, f->indirect->file_blocks[f->pos_in_block]);
-					if (snorlax == TBA) {
-						printf ("ERROR READING @ AUX_indirect_management()\n");
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					// Updating f
-					f->indirect = aux_node;
-					f->current_block = &(aux_node->header);
-					f->pos_in_node = 0;
-					f->pos_in_block = 0;
-					
-				}
-			}
-			// NO MORE SPACE
-			else {
-				printf ("TOO LARGE FILE @ AUX_indirect_management()\n");
-				return;
-			}
-			
+		if (aux_node->num_extents > INODE_EXT_SIZE) {
+			DiskDriver_releaseBlock(disk, aux_node);
+			break;
 		}
-		// We are in a double indirect NOD
-		else if (f->indirect->icb.upper == f->fcb->double_indirect && 
-				f->indirect->header.block_in_disk != f->fcb->double_indirect) {
-
-			// If the next one does not exists, create and move
-			if (f->pos_in_node < indirect_idx_size) return;
-			else {
-				// Read the parent node
-				snorlax = DiskDriver_readBlock(disk, aux_node, f->indirect->icb.upper);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ AUX_indirect_management()\n");
-					
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);
-					return;
-				}
-				// Check if the next NOD exists.
-				// if exists, move
-				if (aux_node->file_blocks[f->indirect->header.block_in_node+1] != TBA) {
-					snorlax = DiskDriver_readBlock(disk, aux_node, aux_node->file_blocks[f->indirect->header.block_in_node+1]);
-					if (snorlax == TBA) {
-						printf ("ERROR READING @ AUX_indirect_management()\n");
-					
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						return;
-					}
-					
-					f->indirect = aux_node;
-					f->current_block = &(aux_node->header);
-					f->pos_in_node = 0;
-					f->pos_in_block = 0;
-				}
-				// else if it does not exists AND mode == WRITE, create and move
-				else if (aux_node->file_blocks[f->indirect->header.block_in_node+1] == TBA && 
-						mode ==	WRITE) {
-					iNode_indirect* another_node = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-					memset(another_node, 0, BLOCK_SIZE);
-					int voyager = DiskDriver_getFreeBlock(disk, 0);
-					if (voyager == TBA) {
-						printf ("ERROR DISK FULL @ AUX_indirect_management()\n");
-						return;
-					}
-					
-					// Creating blockheader
-					BlockHeader header;
-					header.block_in_file = TBA;
-					header.block_in_node = f->indirect->header.block_in_node+1;
-					header.block_in_disk = voyager;
-					
-					// Creating icb
-					iNodeControlBlock icb;
-					if (f->directory != NULL) {
-						icb.directory_block = f->directory->header.block_in_disk;
-					} else icb.directory_block = TBA;
-					icb.block_in_disk = header.block_in_disk;
-					icb.upper = aux_node->header.block_in_disk;
-					icb.node_type = NOD;
-					
-					// NOD stuffs
-					another_node->header = header;
-					another_node->icb = icb;
-					another_node->num_entries = 0;
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						another_node->file_blocks[i] = TBA;
-					}
-					
-					// Writing on the disk
-					snorlax = DiskDriver_writeBlock(disk, another_node, another_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						another_node = NULL;
-						free (another_node);
-						return;
-					}
-					
-					// Updating aux_node
-					aux_node->file_blocks[another_node->header.block_in_node] = another_node->header.block_in_disk;
-					snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						another_node = NULL;
-						free (another_node);
-						return;
-					}
-					
-					// Update d->dcb sizes
-					f->fcb->fcb.size_in_blocks += 1;
-					f->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-					snorlax = DiskDriver_writeBlock(disk, f->fcb, f->fcb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ AUX_indirect_dir_management()\n");
-						
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);
-						another_node = NULL;
-						free (another_node);
-						return;
-					}
-					
-					// Updating d
-					f->indirect = another_node;
-					f->current_block = &(another_node->header);
-					f->pos_in_node = 0;
-					f->pos_in_block = 0;
-					
-					// Freeing aux_node
-					aux_node = NULL;
-					free (aux_node);
-					
-				}
-			}
+		memcpy(node->extents, aux_node->extents, aux_node->num_extents * sizeof(Extent));
+		node->num_extents = aux_node->num_extents;
+		node->depth = aux_node->depth;
+		DiskDriver_releaseBlock(disk, aux_node);
+		
+		DiskDriver_freeBlock(disk, voyager);
+		node->fcb.size_in_blocks -= 1;
+		node->fcb.size_in_bytes -= disk->block_size;
+	}
+	
+	return 0;
+}
+
+// returns the number of blocks of node up to the end of its last extent
+int AUX_extent_end(DiskDriver* disk, iNode* node) {
+	
+	// Going down the tree along the last records
+	Extent* recs = node->extents;
+	int num = node->num_extents;
+	int depth = node->depth;
+	int voyager = 0;
+	ExtentNode* aux_node = NULL;
+	ExtentNode* child = NULL;
+	
+	while (num > 0) {
+		if (depth == 0) {
+			voyager = recs[num - 1].block_in_file + recs[num - 1].len;
+			break;
 		}
-	}	
+		child = (ExtentNode*) DiskDriver_getBlockPtr(disk, recs[num - 1].block_in_disk, BLOCK_READ);
+		DiskDriver_releaseBlock(disk, aux_node);
+		aux_node = child;
+		if (aux_node == NULL) {
+			printf ("ERROR READING @ AUX_extent_end()\n");
+			break;
+		}
+		recs = aux_node->extents;
+		num = aux_node->num_extents;
+		depth = aux_node->depth;
+	}
+	DiskDriver_releaseBlock(disk, aux_node);
+	
+	return voyager;
 }
 
-// writes in the file, at current position for size bytes stored in data
-// overwriting and allocating new space if necessary
-// returns the number of bytes written
-int iNodeFS_write(FileHandle* f, void* data, int size) {
+// returns the block in disk that stores the block_in_file-th block of fcb (a FIL or a DIR),
+// searching its extent tree without using any handle
+// mode == WRITE : a missing block is created, placing it (and the ExtentNodes) from hint on
+// returns -1 if the block does not exist (READ) or can't be created (WRITE)
+int AUX_file_block(DiskDriver* disk, iNode* fcb, int block_in_file, int hint, int mode) {
+	
+	if (block_in_file < 0) return TBA;
+	int voyager = AUX_extent_lookup(disk, fcb, block_in_file, NULL);
+	if (voyager != TBA || mode != WRITE) return voyager;
+	
+	// Creating the block, as iNodeFS_write does. A FIL's data block has no header,
+	// a DIR's DirectoryBlock has one
+	voyager = DiskDriver_allocExtent(disk, hint, 1, 1, NULL);
+	if (voyager == TBA || AUX_extent_insert(disk, fcb, block_in_file, voyager, 1, voyager + 1) == TBA) {
+		if (voyager != TBA) DiskDriver_freeBlock(disk, voyager);
+		printf ("ERROR DISK FULL @ AUX_file_block()\n");
+		return TBA;
+	}
+	
+	char* aux_fb = (char*) DiskDriver_getBlockPtr(disk, voyager, BLOCK_WRITE);
+	memset(aux_fb, 0, disk->block_size);
+	if (fcb->fcb.icb.node_type == DIR) {
+		BlockHeader* header = (BlockHeader*) aux_fb;
+		header->block_in_file = block_in_file;
+		header->block_in_node = TBA;
+		header->block_in_disk = voyager;
+	}
+	DiskDriver_releaseBlock(disk, aux_fb);
+	
+	fcb->fcb.size_in_blocks += 1;
+	fcb->fcb.size_in_bytes += disk->block_size;
+	
+	return voyager;
+}
+
+// reads size bytes of the file from offset on and stores them in data
+// it does not use nor move the current position of f
+// returns the number of bytes read: less than size only at the end of the file
+int64_t iNodeFS_pread(FileHandle* f, void* data, int64_t size, int64_t offset) {
 	
 	// Preliminary stuffs
 	if (f == NULL) return TBA;
@@ -1547,741 +1960,438 @@ int iNodeFS_write(FileHandle* f, void* data, int size) {
 	DiskDriver* disk = f->infs->disk;
 	if (disk == NULL) return TBA;
 	if (data == NULL) return TBA;
+	if (offset < 0) {
+		printf ("ERROR NEGATIVE OFFSET @ iNodeFS_pread()\n");
+		return TBA;
+	}
 	
 	// Blocks stuffs
-	FileBlock* aux_fb = (FileBlock*) malloc(sizeof(FileBlock));
-	FileHandle* faux = AUX_duplicate_filehandle(f);
-	int snorlax = TBA;
+	// A run of blocks contiguous on the disk is read in place in the map, with a single copy
+	char* aux_fb = NULL;
 	int voyager = TBA;
+	int run = 0;
+	int block_in_file = 0;
+	int pos_in_block = 0;
+	int last_block = 0;
+	int64_t span = 0;
+	
+	// The read is bounded by the length of the file
+	int64_t to_read = f->fcb->num_entries - offset;
+	if (to_read > size) to_read = size;
+	if (to_read <= 0) return 0;
+	
+	// Inline data: the iNode is all there is to read
+	if (f->fcb->depth == INLINE) {
+		memcpy(data, AUX_inline_data(f->fcb) + offset, to_read);
+		return to_read;
+	}
+	AUX_locate(disk, offset + to_read - 1, &last_block, &pos_in_block);
+	
+	int64_t read_data = 0;
+	while (read_data < to_read) {
+		AUX_locate(disk, offset + read_data, &block_in_file, &pos_in_block);
+		voyager = AUX_extent_lookup(disk, f->fcb, block_in_file, &run);
+		if (run > last_block - block_in_file + 1) run = last_block - block_in_file + 1;
+		span = ((int64_t) run << disk->block_shift) - pos_in_block;
+		if (span > to_read - read_data) span = to_read - read_data;
+		
+		// Blocks that are not mapped read as zeros
+		if (voyager == TBA) {
+			memset((char*)data + read_data, 0, span);
+			read_data += span;
+			continue;
+		}
+		
+		aux_fb = (char*) DiskDriver_getExtentPtr(disk, voyager, run, BLOCK_READ);
+		if (aux_fb == NULL) {
+			printf ("ERROR READING @ iNodeFS_pread()\n");
+			return TBA;
+		}
+		memcpy((char*)data + read_data, aux_fb + pos_in_block, span);
+		read_data += span;
+		DiskDriver_releaseBlock(disk, aux_fb);
+	}
+	
+	// The bytes after the valid ones read as zeros, whatever their (preallocated) blocks hold
+	if (offset + read_data > f->fcb->valid_bytes) {
+		int64_t from = (offset > f->fcb->valid_bytes) ? offset : f->fcb->valid_bytes;
+		memset((char*)data + (from - offset), 0, offset + read_data - from);
+	}
+	
+	// The bytes still in the write-back buffer are newer than the ones on the disk
+	AUX_wb_overlay(f->fcb, (char*) data, offset, read_data);
+	
+	return read_data;
+}
 
-	int written_data = 0;
-	while (written_data < size ) {
-		// Check if we are in the firstfileblock
-		if (faux->indirect == NULL) {
-			// Write in the block
-			if (faux->fcb->file_blocks[faux->pos_in_node] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_fb, faux->fcb->file_blocks[faux->pos_in_node]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// Check if the block is full : if not, write, else move f->pos_in_node.
-				// if f->fcb->file_blocks if full we need to create an indexed node
-				if (faux->pos_in_block < FB_text_size) {
-					faux->current_block = &(aux_fb->header);
-					aux_fb->data[faux->pos_in_block] = ((char*)data)[written_data];
-					//strncpy(aux_fb->data, (char*)data, size);
-					
-					//printf ("text: %s, wdata: %d, posinblock: %d, data : %s\n", aux_fb->data, written_data, faux->pos_in_block, (char*)data);
-					
-					++faux->pos_in_block;
-					++written_data;
-					
-					// write
-					snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ iNodeFS_write()\n");
-						
-						// Freeing memory
-						aux_fb = NULL;
-						free (aux_fb);
-						faux = NULL;
-						free (faux);
-						return TBA;
-					}									
-				}
-				// update the current block and the pointers
-				/*** THIS WRITE COULD BE USELESS ***/
-				// The update is on the write just before this, so this is useless
-				// also check at the same point for single indirect
-				else {
-					snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-					if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-					}
-					
-					++faux->pos_in_node;
-					faux->pos_in_block = 0;
-					
-//NB		     	// Verify if the inode's block list is full.
-					// If so, it will be created an indirect node (if not present) and the filehandle is moved to indirect node
-					AUX_indirect_management(faux, WRITE);
-				}				
-			}
-			// or create it 
-			else {
-				memset(aux_fb, 0, BLOCK_SIZE);
-				voyager = DiskDriver_getFreeBlock(disk, 0);
-				if (voyager == TBA) {
-					printf ("ERROR DISK FULL @ iNodeFS_write()\n");
-					return TBA;
-				}
-				
-				// Header creation
-				BlockHeader header;
-				header.block_in_file = faux->current_block->block_in_file+1;
-				header.block_in_node = faux->pos_in_node;
-				header.block_in_disk = voyager;
-				
-				// Setting array
-				for (int i = 0; i < FB_text_size; ++i) {
-					aux_fb->data[i] = 0;
-				}
-				
-				aux_fb->header = header;
-				
-				// Writing on disk
-				snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// Updating f->fcb
-				//faux->fcb->num_entries += 1;
-				faux->fcb->file_blocks[faux->pos_in_node] = aux_fb->header.block_in_disk;
-				faux->fcb->fcb.size_in_blocks += 1;
-				faux->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-				snorlax = DiskDriver_writeBlock(disk, faux->fcb, faux->fcb->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-			
+// writes size bytes stored in data in the file, from offset on
+// overwriting and allocating new space if necessary (when the write-back buffer is placed on the disk).
+// If offset is past the end of the file the gap reads as zeros. It does not use nor move the current position of f
+// returns the number of bytes written, -1 on error (or if the file was removed while f was open)
+int64_t iNodeFS_pwrite(FileHandle* f, void* data, int64_t size, int64_t offset) {
+	
+	// Preliminary stuffs
+	if (f == NULL) return TBA;
+	if (f->infs == NULL) return TBA;
+	DiskDriver* disk = f->infs->disk;
+	if (disk == NULL) return TBA;
+	if (data == NULL) return TBA;
+	if (offset < 0) {
+		printf ("ERROR NEGATIVE OFFSET @ iNodeFS_pwrite()\n");
+		return TBA;
+	}
+	
+	int64_t written_data = 0;
+	if (AUX_wb_write(f->infs, f->fcb, data, size, offset, &written_data) == TBA) return TBA;
+	return written_data;
+}
+
+// reserves the blocks of the file of f from offset on for len bytes, without writing them:
+// the missing ones are allocated in runs as long as the disk allows, and mapped by the extents in one pass.
+// The length of the file grows to offset + len, unless flags has FALLOC_KEEP_SIZE.
+// The blocks are cleared now, unless flags has FALLOC_LAZY_ZERO: then they're cleared when the file is
+// written after them, and until then they read as zeros
+// returns 0 on success, -1 on error (the disk is full, or the file was removed while f was open).
+// The runs allocated before the disk fills up stay in the file
+int iNodeFS_fallocate(FileHandle* f, int64_t offset, int64_t len, int flags) {
+	
+	// Preliminary stuffs
+	if (f == NULL) return TBA;
+	if (f->infs == NULL) return TBA;
+	DiskDriver* disk = f->infs->disk;
+	if (disk == NULL) return TBA;
+	if (offset < 0 || len <= 0) {
+		printf ("ERROR BAD RANGE @ iNodeFS_fallocate()\n");
+		return TBA;
+	}
+	iNode* fcb = f->fcb;
+	int64_t end = offset + len;
+	if (end > FILE_MAX_BYTES(disk->block_shift)) {
+		printf ("ERROR FILE TOO LONG @ iNodeFS_fallocate()\n");
+		return TBA;
+	}
+	if (AUX_cached(fcb)->removed) {
+		printf ("ERROR FILE REMOVED @ iNodeFS_fallocate()\n");
+		return TBA;
+	}
+	
+	// Blocks stuffs
+	char* aux_fb = NULL;
+	int voyager = TBA;
+	int run = 0;
+	int block_in_file = 0;
+	int first_block = 0;
+	int last_block = 0;
+	int pos_in_block = 0;
+	int missing = 0;
+	int ret = 0;
+	int64_t run_start = 0;
+	int64_t stop = 0;
+	
+	// Inline data leaves the iNode: the extents go in its place
+	if (fcb->depth == INLINE) {
+		if (AUX_inline_move_out(f->infs, fcb) == TBA) return TBA;
+		AUX_idirty(fcb);
+	}
+	AUX_locate(disk, offset, &first_block, &pos_in_block);
+	AUX_locate(disk, end - 1, &last_block, &pos_in_block);
+	
+	// Counting the missing blocks first (and the ExtentNodes a split could take),
+	// so that the disk is not filled for nothing
+	for (block_in_file = first_block; block_in_file <= last_block; block_in_file += run) {
+		voyager = AUX_extent_lookup(disk, fcb, block_in_file, &run);
+		if (run > last_block - block_in_file + 1) run = last_block - block_in_file + 1;
+		if (voyager == TBA) missing += run;
+	}
+	if ((int64_t) missing + fcb->depth + 1 > disk->header->free_blocks) {
+		printf ("ERROR DISK FULL @ iNodeFS_fallocate()\n");
+		return TBA;
+	}
+	
+	// Allocating the holes as long runs, each one placed right after the block before it
+	voyager = (first_block > 0) ? AUX_extent_lookup(disk, fcb, first_block - 1, NULL) : TBA;
+	int hint = (voyager != TBA) ? voyager + 1 : AUX_node_hint(f->infs, fcb);
+	for (block_in_file = first_block; block_in_file <= last_block; block_in_file += run) {
+		voyager = AUX_extent_lookup(disk, fcb, block_in_file, &run);
+		if (run > last_block - block_in_file + 1) run = last_block - block_in_file + 1;
+		if (voyager == TBA) {
+			voyager = DiskDriver_allocExtent(disk, hint, 1, run, &run);
+			if (voyager == TBA) {
+				printf ("ERROR DISK FULL @ iNodeFS_fallocate()\n");
+				ret = TBA;
+				break;
 			}
 			
-		}
-		// Check if we are in a single_indirect
-		// single_idirect : same thing of first node
-		else if (faux->indirect != NULL && 
-				faux->indirect->header.block_in_disk == faux->fcb->single_indirect ) {
-			
-			// Write int he block...
-			if (faux->indirect->file_blocks[faux->pos_in_node] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_fb, faux->indirect->file_blocks[faux->pos_in_node]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				// Check if the block is full : if not, write, else move f->pos_in_node
-				// if faux->indirect->file_blocks is full we need to create a double indirect
-				if (faux->pos_in_block < FB_text_size) {
-					faux->current_block = &(aux_fb->header);
-					aux_fb->data[faux->pos_in_block] = ((char*)data)[written_data];
-					++faux->pos_in_block;
-					++written_data;
-					
-					// write
-					snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-					if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-					}
-					
-				}
-				// Update the current block and the pointers
-				else {
-					snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-					if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-					}
-					
-					++faux->pos_in_node;
-					faux->pos_in_block = 0;
-					
-/*NB*/				AUX_indirect_management(faux, WRITE);
-				}
+			// A hole before the valid bytes reads as zeros: its new blocks can hold old data, so they're cleared now
+			run_start = (int64_t) block_in_file << disk->block_shift;
+			if (run_start < fcb->valid_bytes) {
+				stop = run_start + ((int64_t) run << disk->block_shift);
+				if (stop > fcb->valid_bytes) stop = fcb->valid_bytes;
+				aux_fb = (char*) DiskDriver_getExtentPtr(disk, voyager, run, BLOCK_WRITE);
+				if (aux_fb == NULL) {
+					DiskDriver_freeExtent(disk, voyager, run);
+					printf ("ERROR WRITING @ iNodeFS_fallocate()\n");
+					ret = TBA;
+					break;
+				}
+				memset(aux_fb, 0, stop - run_start);
+				DiskDriver_releaseBlock(disk, aux_fb);
 			}
-			// ...or create it
-			else {
-				memset(aux_fb, 0, BLOCK_SIZE);
-				voyager = DiskDriver_getFreeBlock(disk, 0);
-				if (voyager == TBA) {
-					printf ("ERROR DISK FULL @ iNodeFS_write()\n");
-					return TBA;
-				}
-				
-				// Header Creation
-				BlockHeader header;
-				header.block_in_file = faux->current_block->block_in_file+1;
-				header.block_in_node = faux->pos_in_node;
-				header.block_in_disk = voyager;
-				
-				// Setting array
-				for (int i = 0; i < FB_text_size; ++i) {
-					aux_fb->data[i] = 0;
-				}
-				
-				aux_fb->header = header;
-				
-				// Writing on disk
-				snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// Updating faux->fcb
-				//faux->fcb->num_entries += 1;
-				faux->indirect->file_blocks[faux->pos_in_node] = aux_fb->header.block_in_disk;
-				faux->fcb->fcb.size_in_blocks += 1;
-				faux->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-				
-				// fcb
-				snorlax = DiskDriver_writeBlock(disk, faux->fcb, faux->fcb->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// indirect
-				snorlax = DiskDriver_writeBlock(disk, faux->indirect, faux->indirect->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-			}	
-		}
-		// Check if we are in a double_indirect
-		// In this case I only have to pass faux to a double_indirect's NOD.
-		else if (faux->indirect != NULL && 
-				faux->indirect->icb.upper == faux->fcb->header.block_in_disk) {
-			
-			AUX_indirect_management(faux, WRITE);
-			
-		}
-		// Check if we are in a double_indirect's NOD
-		else if (faux->indirect != NULL &&
-				faux->indirect->icb.upper == faux->fcb->double_indirect) {
 			
-			// Write in the block...
-			if (faux->indirect->file_blocks[faux->pos_in_node] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_fb, faux->indirect->file_blocks[faux->pos_in_node]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				// Check if the block is full : if not, write, else move f->pos_in_node
-				// if faux->indirect->file_blocks is full, call the manager
-				if (faux->pos_in_block < FB_text_size) {
-					faux->current_block = &(aux_fb->header);
-					aux_fb->data[faux->pos_in_block] = ((char*)data)[written_data];
-					++faux->pos_in_block;
-					++written_data;
-					
-					// write
-					snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-						// Freeing memory
-						aux_fb = NULL;
-						free (aux_fb);
-						faux = NULL;
-						free (faux);
-						return TBA;
-					}
-				}
-				// Update the current block and the pointers
-				else {
-					snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-					if (snorlax == TBA) {
-						printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-						// Freeing memory
-						aux_fb = NULL;
-						free (aux_fb);
-						faux = NULL;
-						free (faux);
-						return TBA;
-					}
-					
-					++faux->pos_in_node;
-					faux->pos_in_block = 0;
-					
-					AUX_indirect_management(faux, WRITE);
-				}
+			if (AUX_extent_insert(disk, fcb, block_in_file, voyager, run, voyager + run) == TBA) {
+				DiskDriver_freeExtent(disk, voyager, run);
+				printf ("ERROR DISK FULL @ iNodeFS_fallocate()\n");
+				ret = TBA;
+				break;
 			}
-			//... or create it
-			else {
-				memset(aux_fb, 0, BLOCK_SIZE);
-				voyager = DiskDriver_getFreeBlock(disk, 0);
-				if (voyager == TBA) {
-					printf ("ERROR DISK FULL @ iNodeFS_write()\n");
-					return TBA;
-				}
-				
-				// Header Creation
-				BlockHeader header;
-				header.block_in_file = faux->current_block->block_in_file+1;
-				header.block_in_node = faux->pos_in_node;
-				header.block_in_disk = voyager;
-				
-				// Setting array
-				for (int i = 0; i < FB_text_size; ++i) {
-					aux_fb->data[i] = 0;
-				}
-				
-				aux_fb->header = header;
-				
-				// Writing on disk
-				snorlax = DiskDriver_writeBlock(disk, aux_fb, aux_fb->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// Updating fuax->fcb
-				//faux->fcb->num_entries += 1;
-				faux->indirect->file_blocks[faux->pos_in_node] = aux_fb->header.block_in_disk;
-				faux->fcb->fcb.size_in_blocks += 1;
-				faux->fcb->fcb.size_in_bytes += BLOCK_SIZE;
-				
-				// fcb
-				snorlax = DiskDriver_writeBlock(disk, faux->fcb, faux->fcb->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// indirect
-				snorlax = DiskDriver_writeBlock(disk, faux->indirect, faux->indirect->header.block_in_disk);
-				if (snorlax == TBA) {
-					printf ("ERROR WRITING @ iNodeFS_write()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}				
-			}			
+			fcb->fcb.size_in_blocks += run;
+			fcb->fcb.size_in_bytes += (int64_t) run << disk->block_shift;
 		}
+		hint = voyager + run;
 	}
 	
-	// Updating number of effective bytes
-	faux->fcb->num_entries += written_data;
-	snorlax = DiskDriver_writeBlock(disk, faux->fcb, faux->fcb->header.block_in_disk);
-	if (snorlax == TBA) {
-		printf ("ERROR WRITING @ iNodeFS_write()\n");
-		
-		// Freeing memory
-		aux_fb = NULL;
-		free (aux_fb);
-		faux = NULL;
-		free (faux);
-		return TBA;
-	}		
-	
-	// Updating f with faux
-	f->indirect = faux->indirect;
-	f->current_block = faux->current_block;
-	f->pos_in_node = faux->pos_in_node;
-	f->pos_in_block = faux->pos_in_block;
-	
-	// Freeing memory
-	aux_fb = NULL;
-	free (aux_fb);
-	faux = NULL;
-	free (faux);
+	// Clearing now: the range is valid, as if it was written with zeros
+	if (ret == 0 && !(flags & FALLOC_LAZY_ZERO) && end > fcb->valid_bytes) {
+		ret = AUX_file_zero(disk, fcb, fcb->valid_bytes, end);
+		if (ret == 0) fcb->valid_bytes = end;
+	}
+	if (ret == 0 && !(flags & FALLOC_KEEP_SIZE) && end > fcb->num_entries) fcb->num_entries = end;
+	AUX_idirty(fcb);
 	
-	return written_data;
+	return ret;
 }
 
-// reads in the file, at current position size bytes and stores them in data
-// returns the number of bytes read
-int iNodeFS_read(FileHandle* f, void* data, int size) {
+// sets the length of the file of f to new_size. A shorter file gives back all its blocks after new_size
+// (the preallocated ones too), a longer one reads as zeros after its old end, with no new blocks
+// returns 0 on success, -1 on error
+int iNodeFS_truncate(FileHandle* f, int64_t new_size) {
 	
 	// Preliminary stuffs
 	if (f == NULL) return TBA;
 	if (f->infs == NULL) return TBA;
 	DiskDriver* disk = f->infs->disk;
 	if (disk == NULL) return TBA;
-	if (data == NULL) return TBA;
+	if (new_size < 0 || new_size > FILE_MAX_BYTES(disk->block_shift)) {
+		printf ("ERROR BAD SIZE @ iNodeFS_truncate()\n");
+		return TBA;
+	}
+	iNode* fcb = f->fcb;
+	CachedNode* cached = AUX_cached(fcb);
+	
+	// The buffered bytes after new_size are dropped
+	if (cached->wb_len > 0 && cached->wb_start + cached->wb_len > new_size) {
+		int64_t keep = (new_size > cached->wb_start) ? new_size - cached->wb_start : 0;
+		f->infs->icache.wb_bytes -= cached->wb_len - keep;
+		cached->wb_len = keep;
+	}
 	
-	// Blocks stuffs
-	FileBlock* aux_fb = (FileBlock*) malloc(sizeof(FileBlock));
-	FileHandle* faux = AUX_duplicate_filehandle(f);
-	int snorlax = TBA;
-	
-	int read_data = 0;
-	while (read_data < size) {
-		// Check if we are in the firstfileblock		
-		if (faux->indirect == NULL) {
-			// Read the block
-			if (faux->fcb->file_blocks[faux->pos_in_node] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_fb, faux->fcb->file_blocks[faux->pos_in_node]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_read()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}
-				
-				// Check if the block is full : if not, read, else move f->pos_in_node.
-				if (faux->pos_in_block < FB_text_size) {
-					faux->current_block = &(aux_fb->header);
-					if (aux_fb->data[faux->pos_in_block] == '\0') break;
-					((char*)data)[read_data] = aux_fb->data[faux->pos_in_block];
-				
-					++faux->pos_in_block;
-					++read_data;
-				}
-				// update the pointers
-				else {
-					++faux->pos_in_node;
-					faux->pos_in_block = 0;
-					
-					AUX_indirect_management(faux, READ);
-				}
-			}
-		}
-		// Check if we are in a single_indirect
-		//single_idirect : same thing of first node
-		else if (faux->indirect != NULL && faux->indirect->icb.upper == faux->fcb->header.block_in_disk){
-			snorlax = DiskDriver_readBlock(disk, aux_fb, faux->indirect->file_blocks[faux->pos_in_node]);
-			if (snorlax == TBA) {
-				printf ("ERROR READING @ iNodeFS_read()\n");
-				
-				// Freeing memory
-				aux_fb = NULL;
-				free (aux_fb);
-				faux = NULL;
-				free (faux);
-				return TBA;
-			}
-			
-			// Check if the block is full : if not, read, else move f->pos_in_node
-			if (faux->pos_in_block < FB_text_size) {
-				faux->current_block = &(aux_fb->header);
-				((char*)data)[read_data] = aux_fb->data[faux->pos_in_block];
-				++faux->pos_in_block;
-				++read_data;
-			
-			}
-			// Update the pointers
-			else {
-				++faux->pos_in_node;
-				faux->pos_in_block = 0;
-				
-				AUX_indirect_management(faux, READ);
-			}
-		}
-		// Check if we are in a double_indirect
-		else if (faux->indirect != NULL &&
-				faux->indirect->icb.upper == faux->fcb->header.block_in_disk) {
-			
-			AUX_indirect_management(faux, READ);
-			
-		}
-		// Check if we are in a double_indirect's NOD
-		else if (faux->indirect != NULL && 
-				faux->indirect->icb.upper == faux->fcb->double_indirect) {
-			
-			// Read the block
-			if (faux->indirect->file_blocks[faux->pos_in_node] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_fb, faux->indirect->file_blocks[faux->pos_in_node]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_read()\n");
-					
-					// Freeing memory
-					aux_fb = NULL;
-					free (aux_fb);
-					faux = NULL;
-					free (faux);
-					return TBA;
-				}				
-				
-				// Check if the block is full : if not, read, else move f->pos_in_node.
-				if (faux->pos_in_block < FB_text_size) {
-					faux->current_block = &(aux_fb->header);
-					if (aux_fb->data[faux->pos_in_block] == '\0') break;
-					((char*)data)[read_data] = aux_fb->data[faux->pos_in_block];
-				
-					++faux->pos_in_block;
-					++read_data;
-				}
-				
-				// Update the pointers
-				else {
-					++faux->pos_in_node;
-					faux->pos_in_block = 0;
-					
-					AUX_indirect_management(faux, READ);
-				}
-				
-			}
-			
+	// Inline data: clearing what's cut, so that a longer file reads zeros there.
+	// A file growing out of the iNode is moved out (the data past the end is a hole, no block is taken)
+	if (fcb->depth == INLINE) {
+		if (new_size <= INODE_INLINE_SIZE) {
+			if (new_size < fcb->num_entries) memset(AUX_inline_data(fcb) + new_size, 0, fcb->num_entries - new_size);
+			fcb->num_entries = new_size;
+			if (fcb->valid_bytes > new_size) fcb->valid_bytes = new_size;
+			AUX_idirty(fcb);
+			return 0;
 		}
+		if (AUX_inline_move_out(f->infs, fcb) == TBA) return TBA;
 	}
-
-	// Updating f with faux
-	f->indirect = faux->indirect;
-	f->current_block = faux->current_block;
-	f->pos_in_node = faux->pos_in_node;
-	f->pos_in_block = faux->pos_in_block;
-	
-	// Freeing memory
-	aux_fb = NULL;
-	free (aux_fb);
-	faux = NULL;
-	free (faux);
 	
+	// Giving back the blocks after the one of the last byte. What's left of that block after new_size
+	// is past the valid bytes, so it reads as zeros and it's cleared before being written again
+	int ret = 0;
+	if (new_size < fcb->num_entries || ((int64_t) AUX_extent_end(disk, fcb) << disk->block_shift) > new_size) {
+		int from = (new_size + disk->block_size - 1) >> disk->block_shift;
+		ret = AUX_extent_remove(disk, fcb, from, AUX_extent_end(disk, fcb), AUX_node_hint(f->infs, fcb));
+	}
+	if (ret == 0) {
+		fcb->num_entries = new_size;
+		if (fcb->valid_bytes > new_size) fcb->valid_bytes = new_size;
+	}
+	else printf ("ERROR FREEING BLOCKS @ iNodeFS_truncate()\n");
+	AUX_idirty(fcb);
 	
-	return read_data;
+	return ret;
 }
 
-// returns the number of bytes read (moving the current pointer to pos)
-// returns pos on success
-// -1 on error (file too short)
-int iNodeFS_seek(FileHandle* f, int pos) {
+// clears len bytes of the file of f from offset on, giving back the blocks in the range:
+// they read as zeros, and the length of the file does not change
+// returns 0 on success, -1 on error
+int iNodeFS_punchHole(FileHandle* f, int64_t offset, int64_t len) {
 	
 	// Preliminary stuffs
 	if (f == NULL) return TBA;
 	if (f->infs == NULL) return TBA;
 	DiskDriver* disk = f->infs->disk;
 	if (disk == NULL) return TBA;
-	if (pos < 0) {
-		printf ("ERROR NEGATIVE SEEK INPUT @ iNodeFS_seek()\n");
+	if (offset < 0 || len <= 0) {
+		printf ("ERROR BAD RANGE @ iNodeFS_punchHole()\n");
 		return TBA;
 	}
+	iNode* fcb = f->fcb;
+	CachedNode* cached = AUX_cached(fcb);
+	int64_t end = offset + len;
+	if (end > FILE_MAX_BYTES(disk->block_shift)) end = FILE_MAX_BYTES(disk->block_shift);
+	
+	// The buffered bytes in the range are cleared
+	if (cached->wb_len > 0) {
+		int64_t from = (offset > cached->wb_start) ? offset : cached->wb_start;
+		int64_t to = (end < cached->wb_start + cached->wb_len) ? end : cached->wb_start + cached->wb_len;
+		if (from < to) memset(cached->wb_data + (from - cached->wb_start), 0, to - from);
+	}
+	
+	// Inline data has no blocks: it's only cleared
+	if (fcb->depth == INLINE) {
+		if (offset < INODE_INLINE_SIZE) {
+			memset(AUX_inline_data(fcb) + offset, 0, ((end < INODE_INLINE_SIZE) ? end : INODE_INLINE_SIZE) - offset);
+			AUX_idirty(fcb);
+		}
+		return 0;
+	}
+	
+	// The whole blocks in the range are given back, the parts of the ones at its edges are cleared
+	int first_block = (offset + disk->block_size - 1) >> disk->block_shift;
+	int last_block = end >> disk->block_shift;
+	int ret = 0;
+	if (((int64_t) first_block << disk->block_shift) > offset) {
+		int64_t to = (int64_t) first_block << disk->block_shift;
+		ret = AUX_file_zero(disk, fcb, offset, (to < end) ? to : end);
+	}
+	if (ret == 0 && last_block >= first_block && ((int64_t) last_block << disk->block_shift) < end) {
+		ret = AUX_file_zero(disk, fcb, (int64_t) last_block << disk->block_shift, end);
+	}
+	if (ret == 0 && last_block > first_block) {
+		ret = AUX_extent_remove(disk, fcb, first_block, last_block, AUX_node_hint(f->infs, fcb));
+	}
+	if (ret == TBA) printf ("ERROR FREEING BLOCKS @ iNodeFS_punchHole()\n");
+	AUX_idirty(fcb);
+	
+	return ret;
+}
+
+// resolves an absolute path ("/a/b/c") and stores in out the block of its iNode
+// "." and ".." are allowed, and the walk starts from the longest prefix in the cache
+// it does not use any handle
+// 0 on success, -1 if the path does not exist
+int iNodeFS_lookupPath(iNodeFS* fs, const char* path, int* out) {
+	
+	// Preliminary stuffs
+	if (fs == NULL) return TBA;
+	DiskDriver* disk = fs->disk;
+	if (disk == NULL) return TBA;
+	if (path == NULL || out == NULL) return TBA;
+	DentryCache* dc = &fs->dcache;
+	int len = strlen(path);
+	int cacheable = (len < PATH_SIZE);
+	
+	// Hashes of all the prefixes of path (FNV-1a, as AUX_name_hash, goes on char by char)
+	uint32_t hashes[PATH_SIZE];
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < len && cacheable; ++i) {
+		hash ^= (uint8_t) path[i];
+		hash *= 16777619u;
+		hashes[i] = hash;
+	}
 	
-	int snorlax = TBA;
-	int pos_in_node = TBA;
-	int pos_in_block = TBA;
-	int inode_size = inode_idx_size * FB_text_size;
-	int indirect_size = indirect_idx_size * FB_text_size;
-	int double_indirect_size = indirect_idx_size * indirect_idx_size * FB_text_size;
+	// Starting from the root, or from the longest cached prefix
+	int voyager = 0;
+	int pos = 0;
+	PathPrefix* prefix = NULL;
+	for (int end = len - 1; end > 0 && cacheable; --end) {
+		if (path[end] != '/' || path[end - 1] == '/') continue;
+		prefix = &dc->prefixes[hashes[end - 1] % PCACHE_SIZE];
+		if (prefix->block_in_disk != TBA && prefix->generation == dc->generation && prefix->len == end &&
+				prefix->hash == hashes[end - 1] && memcmp(prefix->path, path, end) == 0) {
+			dc->prefix_hits += 1;
+			voyager = prefix->block_in_disk;
+			pos = end;
+			break;
+		}
+	}
 	
-/*	
-	f->pos_in_node = 0;
-	f->pos_in_block = 0;
-	f->indirect = NULL;
-	f->current_block = &(f->fcb->header);
-*/
+	// Walking the rest of the path, a name at a time
+	// The directories come from the iNode cache, that has their latest version
+	char name[NAME_SIZE];
+	iNode* dir = NULL;
+	int end = 0;
+	int last = 0;
+	while (pos < len) {
+		if (path[pos] == '/') {
+			++pos;
+			continue;
+		}
+		for (end = pos; end < len && path[end] != '/'; ++end);
+		if (end - pos >= NAME_SIZE) return TBA;
+		memcpy(name, path + pos, end - pos);
+		name[end - pos] = '\0';
 		
-	// Calculating the position
-	if (pos < inode_size) {
-		pos_in_node = pos / FB_text_size;
-		pos_in_block = pos % FB_text_size;
+		// Only the last name can be a FIL
+		for (last = end; last < len && path[last] == '/'; ++last);
+		last = (last == len);
 		
-		if (f->fcb->file_blocks[pos_in_node] != TBA) {
-			FileBlock* aux_fb = (FileBlock*) malloc(sizeof(FileBlock));
-			snorlax = DiskDriver_readBlock(disk, aux_fb, f->fcb->file_blocks[pos_in_node]);
-			if (snorlax == TBA) {
-				printf ("ERROR READING @ iNodeFS_seek()\n");
-				
-				// Free memory
-				aux_fb = NULL;
-				free (aux_fb);
-				
-				return TBA;
-			}
-			
-			// Updating f
-			f->current_block = &(aux_fb->header);
-			f->pos_in_node = pos_in_node;
-			f->pos_in_block = pos_in_block;
-			f->indirect = NULL;
-			
-			return (pos_in_node + pos_in_block);
-		}
-		else {
-			printf ("ERROR BAD SEEK INPUT @ iNodeFS_seek()\n");
+		dir = AUX_iget(fs, voyager);
+		if (dir == NULL) {
+			printf ("ERROR READING @ iNodeFS_lookupPath()\n");
 			return TBA;
 		}
-	}
-	// we are in the single_indirect
-	else if (pos >= inode_size && pos < (inode_size + indirect_size) ) {
-		pos_in_node = (pos - inode_size) / FB_text_size;
-		pos_in_block = (pos - inode_size) % FB_text_size;
-		
-		if (f->fcb->single_indirect != TBA) {
-			iNode_indirect* aux_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-			snorlax = DiskDriver_readBlock(disk, aux_indirect, f->fcb->single_indirect);
-			if (snorlax == TBA) {
-				printf ("ERROR READING @ iNodeFS_seek()\n");
-				
-				// Free memory
-				aux_indirect = NULL;
-				free (aux_indirect);
-				
-				return TBA;
-			}
-			
-			if (aux_indirect->file_blocks[pos_in_node] != TBA) {
-				FileBlock* aux_fb = (FileBlock*) malloc(sizeof(FileBlock));
-				snorlax = DiskDriver_readBlock(disk, aux_fb, f->fcb->file_blocks[pos_in_node]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_seek()\n");
-					
-					// Free memory
-					aux_indirect = NULL;
-					free (aux_fb);
-					aux_fb = NULL;
-					free (aux_fb);
-					
-					return TBA;
-				}
-				
-				// Updating f
-				f->current_block = &(aux_fb->header);
-				f->indirect = aux_indirect;
-				f->pos_in_node = pos_in_node;
-				f->pos_in_block = pos_in_block;
-				
-				return (pos_in_node + pos_in_block);
-			}
+		if (strcmp(name, "..") == 0) {
+			if (dir->fcb.icb.directory_block != TBA) voyager = dir->fcb.icb.directory_block;
 		}
-	}
-	// we are in a double_indirect
-	else if (pos >= (inode_size + indirect_size) && pos < double_indirect_size -1) {
-		int pos_in_indirect = (pos - inode_size - indirect_size) / indirect_size;  //Nod in indirect
-		pos_in_node = ((pos - inode_size - indirect_size) % FB_text_size) / FB_text_size; // Pos in indirect's indirect
-		pos_in_block = ((pos - inode_size - indirect_size) % FB_text_size) % FB_text_size;
+		else if (strcmp(name, ".") != 0) {
+			voyager = AUX_cached_lookup(fs, dir, name, last ? ANY : DIR, NULL, NULL);
+		}
+		AUX_iput(fs, dir);
+		if (voyager == TBA) return TBA;
 		
-		if (f->fcb->double_indirect != TBA) {
-			iNode_indirect* aux_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-			snorlax = DiskDriver_readBlock(disk, aux_indirect, f->fcb->single_indirect);
-			if (snorlax == TBA) {
-				printf ("ERROR READING @ iNodeFS_seek()\n");
-				
-				// Free memory
-				aux_indirect = NULL;
-				free (aux_indirect);
-				
-				return TBA;
-			}
-			
-			if (aux_indirect->file_blocks[pos_in_indirect] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_indirect, aux_indirect->file_blocks[pos_in_indirect]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_seek()\n");
-					
-					// Free memory
-					aux_indirect = NULL;
-					free (aux_indirect);
-					
-					return TBA;
-				}
-				
-				if (aux_indirect->file_blocks[pos_in_node] != TBA) {
-					FileBlock* aux_fb = (FileBlock*) malloc(sizeof(FileBlock));
-					snorlax = DiskDriver_readBlock(disk, aux_fb, aux_indirect->file_blocks[pos_in_node]);
-					if (snorlax == TBA) {
-						printf ("ERROR READING @ iNodeFS_seek()\n");
-						
-						// Free memory
-						aux_indirect = NULL;
-						free (aux_fb);
-						aux_fb = NULL;
-						free (aux_fb);
-						
-						return TBA;
-					}
-					
-					
-					// Updating f
-					f->current_block = &(aux_fb->header);
-					f->indirect = aux_indirect;
-					f->pos_in_node = pos_in_node;
-					f->pos_in_block = pos_in_block;
-					
-					return (pos_in_indirect + pos_in_node + pos_in_block);
-				}
-			}
+		// Caching the prefix, that ends at a DIR
+		if (!last && cacheable) {
+			prefix = &dc->prefixes[hashes[end - 1] % PCACHE_SIZE];
+			prefix->block_in_disk = voyager;
+			prefix->generation = dc->generation;
+			prefix->hash = hashes[end - 1];
+			prefix->len = end;
+			memcpy(prefix->path, path, end);
 		}
+		pos = end;
 	}
 	
-	return TBA;
+	*out = voyager;
+	return 0;
+}
+
+// opens the file at the given absolute path. The file should be existing
+FileHandle* iNodeFS_openPath(iNodeFS* fs, const char* path) {
+	
+	// Preliminary stuffs
+	if (fs == NULL) return NULL;
+	DiskDriver* disk = fs->disk;
+	if (disk == NULL) return NULL;
+	
+	// Searching the file
+	int voyager = TBA;
+	int snorlax = iNodeFS_lookupPath(fs, path, &voyager);
+	if (snorlax == TBA) {
+		printf ("FILE %s DOES NOT EXISTS\n", path);
+		return NULL;
+	}
+	
+	// Getting its iNode from the cache
+	iNode* aux_node = AUX_iget(fs, voyager);
+	if (aux_node == NULL || aux_node->fcb.icb.node_type != FIL) {
+		printf ("%s IS NOT A FILE @ iNodeFS_openPath()\n", path);
+		AUX_iput(fs, aux_node);
+		return NULL;
+	}
 	
+	// Creating the filehandle
+	FileHandle* filehandle = AUX_handle_get(fs);
+	filehandle->infs = fs;
+	filehandle->fcb = aux_node;
+	filehandle->directory = NULL;
+	filehandle->pos_in_file = 0;
+	
+	return filehandle;
 }
 
 // seeks for a directory in d. If dirname is equal to ".." it goes one level up
@@ -2293,154 +2403,36 @@ int iNodeFS_changeDir(DirectoryHandle* d, char* dirname) {
 	if (d == NULL) return TBA;
 	if (d->infs == NULL) return TBA;
 	DiskDriver* disk = d->infs->disk;
-	if (d == NULL) return TBA;
-	
-	// Creating an iNode struct to store what I need
-	iNode* aux_node = (iNode*) malloc(sizeof(iNode));
-	int snorlax = TBA;
+	if (disk == NULL) return TBA;
 	
 	// Going back to parent directory
+	// The handle's references go one level up
 	if (strcmp(dirname, "..") == 0) {
-		
 		if (d->directory == NULL) return 0;
 		
-		snorlax = DiskDriver_readBlock(disk, aux_node, d->directory->header.block_in_disk);
-		if (snorlax != TBA) {		
-			d->dcb = aux_node;
-			d->current_block = &(aux_node->header);
-			if (d->dcb->fcb.icb.directory_block != TBA) {
-				snorlax = DiskDriver_readBlock(disk, d->directory, d->dcb->fcb.icb.directory_block);
-			} else d->directory = NULL;
-			
-			return 0;
-		}
-	}
-	
-	// Search in the inode
-	// if snorlax == TBA, the block is free according to the bitmap
-	// else check the node name
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (d->dcb->file_blocks[i] != TBA) {
-			snorlax = DiskDriver_readBlock(disk, aux_node, d->dcb->file_blocks[i]);
-			if (snorlax != TBA) {
-				if (strcmp(aux_node->fcb.name, dirname) == 0 && aux_node->fcb.icb.node_type == DIR) {
-					d->directory = NULL;
-					free (d->directory);
-					d->directory = d->dcb;
-					d->dcb = aux_node;
-					d->current_block = &(aux_node->header);
-										
-					return 0;
-				}
-			}
-		}					
-	}
-	
-	// Single Indirect
-	if (d->dcb->single_indirect != TBA) {
-		iNode_indirect* single_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, single_indirect, d->dcb->single_indirect);
-		if (snorlax == TBA) {
-			printf ("ERROR READING @ iNodeFS_changeDir()\n");
-			
-			// Freeing memory
-			aux_node = NULL;
-			free (aux_node);
-			single_indirect = NULL;
-			free (single_indirect);
-			return TBA;
-		}
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (single_indirect->file_blocks[i] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, aux_node, single_indirect->file_blocks[i]);
-				if (snorlax != TBA) {
-					if (strcmp(aux_node->fcb.name, dirname) == 0 && aux_node->fcb.icb.node_type == DIR) {
-						d->directory = NULL;
-						free (d->directory);
-						d->directory = d->dcb;
-						d->dcb = aux_node;
-						d->current_block = &(aux_node->header);
-						
-						// Freeing memory
-						single_indirect = NULL;
-						free (single_indirect);
-						
-						return 0;
-					}
-				}
-			}
-		}
-		// Freeing memory
-		single_indirect = NULL;
-		free (single_indirect);
+		AUX_iput(d->infs, d->dcb);
+		d->dcb = d->directory;
+		d->current_block = &(d->dcb->header);
+		if (d->dcb->fcb.icb.directory_block != TBA) {
+			d->directory = AUX_iget(d->infs, d->dcb->fcb.icb.directory_block);
+		} else d->directory = NULL;
+		
+		return 0;
 	}
 	
-	// Double Indirect
-	if (d->dcb->double_indirect != TBA) {
-		iNode_indirect* double_indirect = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, double_indirect, d->dcb->double_indirect);
-		if (snorlax == TBA) {
-			printf ("ERROR READING @ iNodeFS_changeDir()\n");
-			
-			// Freeing memory
-			aux_node = NULL;
-			free (aux_node);
-			double_indirect = NULL;
-			free (double_indirect);
-			return TBA;
-		}
-		iNode_indirect* nod = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (double_indirect->file_blocks[i] != TBA) {
-				snorlax = DiskDriver_readBlock(disk, nod, double_indirect->file_blocks[i]);
-				if (snorlax == TBA) {
-					printf ("ERROR READING @ iNodeFS_changeDir()\n");
-			
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);
-					double_indirect = NULL;
-					free (double_indirect);
-					nod = NULL;
-					free (nod);
-					return TBA;
-				}
-				for (int j = 0; j < indirect_idx_size; ++j) {
-					if (nod->file_blocks[j] != TBA) {
-						snorlax = DiskDriver_readBlock(disk, aux_node, nod->file_blocks[j]);
-						if (snorlax != TBA) {
-							if (strcmp(aux_node->fcb.name, dirname) == 0 && aux_node->fcb.icb.node_type == DIR) {
-								d->directory = NULL;
-								free (d->directory);
-								d->directory = d->dcb;
-								d->dcb = aux_node;
-								d->current_block = &(aux_node->header);
-								
-								
-								// Freeing memory
-								double_indirect = NULL;
-								free (double_indirect);
-								nod = NULL;
-								free (nod);
-								return 0;
-							}
-						}						
-					}
-				}
-			}
-		}
-		// Freeing memory
-		nod = NULL;
-		free (nod);
-		double_indirect = NULL;
-		free (double_indirect);		
-	}
+	// Searching the directory in d
+	int voyager = AUX_cached_lookup(d->infs, d->dcb, dirname, DIR, NULL, NULL);
+	if (voyager == TBA) return TBA;
+	iNode* aux_node = AUX_iget(d->infs, voyager);
+	if (aux_node == NULL) return TBA;
 	
-	// Freeing memory
-	aux_node = NULL;
-	free (aux_node);
+	// Updating d
+	AUX_iput(d->infs, d->directory);
+	d->directory = d->dcb;
+	d->dcb = aux_node;
+	d->current_block = &(aux_node->header);
 	
-	return TBA;
+	return 0;
 }
 
 // creates a new directory in the current one (stored in fs->current_directory_block)
@@ -2452,240 +2444,32 @@ int iNodeFS_mkDir(DirectoryHandle* d, char* dirname) {
 	if (d == NULL) return TBA;
 	if (d->infs == NULL) return TBA;
 	DiskDriver* disk = d->infs->disk;
-	if (d == NULL) return TBA;
-	
-	// Creating an iNode struct to store what I need
-	iNode* aux_node = (iNode*) malloc(sizeof(iNode));
-	int snorlax = TBA;
-	int filecount = 0;
-	
-	// Creating a copy of the dirhandle and searching for an already existent file
-	// daux is set to first block of main inode to start the search
-	// first_free_occurrency will be lately set as a duplicate of daux
-	int first_free_flag = TBA;
-	DirectoryHandle* daux = AUX_duplicate_dirhandle(d);
-	daux->indirect = NULL;
-	daux->current_block = &(daux->dcb->header);
-	daux->pos_in_node = 0;
-	daux->pos_in_block = 0;
-	DirectoryHandle* first_free_occurrency;
-	
-	// Search in the inode
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (d->dcb->file_blocks[i] == TBA) {
-			// Update the flag and save the first free occurrence
-			if (first_free_flag == TBA) {
-				first_free_flag = 0;
-				first_free_occurrency = AUX_duplicate_dirhandle(daux);
-			}
-		}
-		// Reading the node to check for equal file name
-		// if snorlax == TBA, the block is free according to the bitmap
-		// else check the node name
-		else {
-			++filecount;
-			snorlax = DiskDriver_readBlock(disk, aux_node, daux->dcb->file_blocks[i]);
-			if (snorlax != TBA) {
-				if (aux_node->fcb.icb.node_type == DIR && strcmp(aux_node->fcb.name, dirname) == 0) {
-					printf ("DIR %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_mkdir()\n", dirname);
-								
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);		
-					daux = NULL;
-					free(daux);
-					first_free_occurrency = NULL;
-					free (first_free_occurrency);
-		
-					return TBA;
-				}
-				daux->current_block = &(aux_node->header);
-			}
-		}
-		++daux->pos_in_node;		
-	}
-
-	// Manager call
-	// Check if we are in the single indirect
-	if (filecount == daux->pos_in_node) {
-		AUX_indirect_dir_management(daux, WRITE);
-	} else {
-		AUX_indirect_dir_management(daux, READ);
-	}
-	
-	filecount = 0;
-	if (daux->indirect != NULL && daux->indirect->header.block_in_disk == daux->dcb->single_indirect) {
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (daux->indirect->file_blocks[i] == TBA) {
-				// Update flag and save first free occurrence
-				if (first_free_flag == TBA) {
-					first_free_flag = 0;
-					first_free_occurrency = AUX_duplicate_dirhandle(daux);
-				}
-			}
-			// Reading the node to check for equal file name
-			else {
-				++filecount;
-				snorlax = DiskDriver_readBlock(disk, aux_node, daux->indirect->file_blocks[i]);
-				if (snorlax != TBA) {
-					if (aux_node->fcb.icb.node_type == DIR && strcmp(aux_node->fcb.name, dirname) == 0){
-						printf ("DIR %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_mkdir()\n", dirname);
-								
-						// Freeing memory
-						aux_node = NULL;
-						free (aux_node);		
-						daux = NULL;
-						free(daux);
-						first_free_occurrency = NULL;
-						free (first_free_occurrency);
-			
-						return TBA;
-					}
-					daux->current_block = &(aux_node->header);
-				}
-			}
-			++daux->pos_in_node;
-		}
-	}
-	
-	// Manager call
-	// Check if we are in the double indirect 
-	if (filecount == daux->pos_in_node) {
-		AUX_indirect_dir_management(daux, WRITE);
-	} else {
-		AUX_indirect_dir_management(daux, READ);
+	if (disk == NULL) return TBA;
+	if (strlen(dirname) >= NAME_SIZE) {
+		printf ("NAME %s TOO LONG. CREATION FAILED @ iNodeFS_mkdir()\n", dirname);
+		return TBA;
 	}
 	
-	// Once here, just calla the manager to check if it's necessary to create a new NOD or not
-	if (daux->indirect != NULL && daux->indirect->header.block_in_disk == daux->dcb->double_indirect) {
-		
-		int upper_pos = daux->indirect->header.block_in_disk;	
-			
-		if (daux->indirect->file_blocks[daux->pos_in_node] == TBA) {
-			AUX_indirect_dir_management(daux, WRITE);
-		} else {
-			AUX_indirect_dir_management(daux, READ);
-		}
-		
-		iNode_indirect* upper = (iNode_indirect*) malloc(sizeof(iNode_indirect));
-		snorlax = DiskDriver_readBlock(disk, upper, upper_pos);
-		if (snorlax == TBA) {			
-			printf ("ERROR READING @ iNodeFS_mkdir()\n");
-					
-			// Freeing memory
-			aux_node = NULL;
-			free (aux_node);		
-			daux = NULL;
-			free(daux);
-			first_free_occurrency = NULL;
-			free (first_free_occurrency);
-			upper = NULL;
-			free (upper);
-
-			return TBA;
-		}		
-	
-		// Now daux is on a NOD. The behavior shold be the same as in a single_indirect:
-		// Calling the manager at this point will automatically create another NOD if needed
-		 for (int i = 0; i < indirect_idx_size; ++i) {
-			
-			if (upper->file_blocks[i] != TBA) {
-				filecount = 0;
-				if (daux->indirect != NULL && daux->indirect->icb.upper == daux->dcb->double_indirect) {
-					for (int i = 0; i < indirect_idx_size; ++i) {
-						if (daux->indirect->file_blocks[i] == TBA) {
-							// Update flag and save first free occurrence
-							if (first_free_flag == TBA) {
-								first_free_flag = 0;
-								first_free_occurrency = AUX_duplicate_dirhandle(daux);
-							}
-						}
-						// Reading the node to check for equal file name
-						else {
-							++filecount;
-							snorlax = DiskDriver_readBlock(disk, aux_node, daux->indirect->file_blocks[i]);
-							if (snorlax != TBA) {
-								if (aux_node->fcb.icb.node_type == DIR && strcmp(aux_node->fcb.name, dirname) == 0) {
-									printf ("DIR %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_mkdir()\n", dirname);
-									
-									// Freeing memory
-									aux_node = NULL;
-									free (aux_node);
-									daux = NULL;
-									free (daux);
-									first_free_occurrency = NULL;
-									free (first_free_occurrency);
-									upper = NULL;
-									free (upper);
-									
-									return TBA;
-								}
-								daux->current_block = &(aux_node->header);
-							}
-						}
-						++daux->pos_in_node;
-					}
-				}
-				if (filecount == daux->pos_in_node) {
-					AUX_indirect_dir_management(daux, WRITE);
-				} else {
-					AUX_indirect_dir_management(daux, READ);
-				}
-				snorlax = DiskDriver_readBlock(disk, upper, upper->header.block_in_disk);
-				if (snorlax == TBA) {			
-					printf ("ERROR READING @ iNodeFS_mkdir()\n");
-							
-					// Freeing memory
-					aux_node = NULL;
-					free (aux_node);		
-					daux = NULL;
-					free(daux);
-					first_free_occurrency = NULL;
-					free (first_free_occurrency);
-					upper = NULL;
-					free (upper);
-
-					return TBA;
-				}				
-			}
-			else {
-				upper = NULL;
-				free (upper);
-				break;
-			}
-		}
+	// Searching for an already existent directory
+	int snorlax = AUX_cached_lookup(d->infs, d->dcb, dirname, DIR, NULL, NULL);
+	if (snorlax != TBA) {
+		printf ("DIR %s ALREADY EXISTS. CREATION FAILED @ iNodeFS_mkdir()\n", dirname);
+		return TBA;
 	}
 	
-/*		
-	printf ("daux pos in node: %d\n", daux->pos_in_node);
-	printf ("daux pos in block: %d\n", daux->pos_in_node);
-	if (daux->indirect != NULL) printf ("daux indirect: %d\n", daux->indirect->icb.block_in_disk);
-	else printf ("daux is on the main node\n");
-	printf ("daux current block: %d\n", daux->current_block->block_in_disk);
-	printf ("FFO pos in node: %d\n", first_free_occurrency->pos_in_node);
-	printf ("FFO pos in block: %d\n", first_free_occurrency->pos_in_node);
-	if (daux->indirect != NULL) printf ("FFO indirect: %d\n", first_free_occurrency->indirect->icb.block_in_disk);
-	else printf ("FFO is on the main node\n");
-	printf ("FFO current block: %d\n\n", first_free_occurrency->current_block->block_in_disk);
-*/
-	
-	// Creation time
-	memset(aux_node, 0, BLOCK_SIZE);
-	int voyager = DiskDriver_getFreeBlock(disk, 0);
+	// Creation time. The directory can be placed in another allocation group, to spread the tree on the disk
+	int voyager = AUX_inode_alloc(d->infs, AUX_dir_group(d->infs, d->dcb));
 	if (voyager == TBA) {
-		printf ("ERROR - DISK COULD BE FULL @ iNodeFS_mkdir()\n");
-		
-		// Freeing memory		
-		daux = NULL;
-		free(daux);
-		
+		printf ("ERROR - INODE TABLE COULD BE FULL @ iNodeFS_mkdir()\n");
 		return TBA;
 	}
+	iNode* aux_node = (iNode*) AUX_scratch_get(d->infs);
+	memset(aux_node, 0, disk->block_size);
 	
 	// Header creation
 	BlockHeader header;
 	header.block_in_file = TBA;
-	header.block_in_node = daux->pos_in_node;
+	header.block_in_node = TBA;
 	header.block_in_disk = voyager;
 	
 	// iNode Control Block creation
@@ -2697,114 +2481,134 @@ int iNodeFS_mkDir(DirectoryHandle* d, char* dirname) {
 	
 	// File Control Block creation
 	FileControlBlock fcb;
-	fcb.size_in_bytes = BLOCK_SIZE;
-	fcb.size_in_blocks = 1;
+	memset(&fcb, 0, sizeof(FileControlBlock));
+	fcb.size_in_bytes = 0;
+	fcb.size_in_blocks = 0;
 	fcb.icb = icb;
-	strcpy(fcb.name, dirname);
 	
 	// Compacting all
 	aux_node->header = header;
 	aux_node->fcb = fcb;
 	aux_node->num_entries = 0;
-	aux_node->single_indirect = TBA;
-	aux_node->double_indirect = TBA;
-	for (int i = 0; i < inode_idx_size; ++i) {
-		aux_node->file_blocks[i] = TBA;
-	}
+	aux_node->depth = 0;
+	aux_node->num_extents = 0;
+	aux_node->index_buckets = 0;
 	
 	// Writing on the disk
-	snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
+	snorlax = AUX_inode_write(d->infs, aux_node);
+	AUX_scratch_put(d->infs, aux_node);
 	if (snorlax == TBA) {
 		printf ("ERROR WRITING AUX NODE ON THE DISK @ iNodeFS_mkdir()\n");
-		
-		// Freeing memory
-		aux_node = NULL;
-		free (aux_node);		
-		daux = NULL;
-		free(daux);
-		
 		return TBA;
 	}
 	
-	// Updating dirhandle
-	// We are in the main node
-	if (first_free_occurrency->indirect == NULL) {
-		d->dcb->file_blocks[first_free_occurrency->pos_in_node] = voyager;
+	// Updating the directory
+	snorlax = AUX_dir_add(d->infs, d->dcb, dirname, DIR, voyager);
+	AUX_dcache_invalidate(&d->infs->dcache, d->dcb->header.block_in_disk, dirname);
+	if (snorlax == TBA) {
+		printf ("ERROR UPDATING DCB ON THE DISK @ iNodeFS_mkdir()\n");
+		AUX_inode_free(d->infs, voyager);
+		return TBA;
 	}
-	// Need another update
-	else {
-		first_free_occurrency->indirect->file_blocks[first_free_occurrency->pos_in_node] = voyager;
-		++first_free_occurrency->indirect->num_entries;
-		snorlax = DiskDriver_writeBlock(disk, first_free_occurrency->indirect, first_free_occurrency->indirect->header.block_in_disk);
-		if (snorlax == TBA) {
-			printf ("ERROR UPDATING DCB ON THE DISK @ iNodeFS_mkdir()\n");
-			return TBA;
-		}
+	
+	return 0;
+}
+
+// converts the current directory of d to a hashed index with the given number of buckets
+// (at most DIR_INDEX_MAX), or back to an unindexed directory if buckets is 0.
+// On error (no room for the new blocks) the directory is left as it was
+// 0 on success
+// -1 on error
+int iNodeFS_indexDir(DirectoryHandle* d, int buckets) {
+	
+	// Preliminary stuffs
+	if (d == NULL) return TBA;
+	if (d->infs == NULL) return TBA;
+	DiskDriver* disk = d->infs->disk;
+	if (disk == NULL) return TBA;
+	if (buckets < 0 || buckets > DIR_INDEX_MAX) {
+		printf ("ERROR WRONG NUMBER OF BUCKETS @ iNodeFS_indexDir()\n");
+		return TBA;
 	}
-	d->dcb->num_entries += 1;
-	snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
+	
+	int snorlax = AUX_dir_reindex(d->infs, d->dcb, buckets);
+	AUX_dcache_invalidate_dir(&d->infs->dcache, d->dcb->header.block_in_disk);
 	if (snorlax == TBA) {
-		printf ("ERROR UPDATING DCB ON THE DISK @ iNodeFS_mkdir()\n");
-			return TBA;
+		printf ("ERROR INDEXING @ iNodeFS_indexDir()\n");
+		return TBA;
 	}
 	
-	d = daux;
-		
-	// Freeing memory	
-	daux = NULL;
-	free(daux);
-	first_free_occurrency = NULL;
-	free (first_free_occurrency);
+	// Updating d->dcb
+	AUX_idirty(d->dcb);
 	
 	return 0;
 }
 
+// Prints the blocks mapped by the num records recs of an extent tree's node of the given depth:
+// the runs of a leaf, then the ExtentNodes under an index node one per line, marked with level '#'
+void AUX_print_extents(DiskDriver* disk, Extent* recs, int num, int depth, int level) {
+	
+	for (int i = 0; i < num; ++i) {
+		if (depth > 0) printf ("%d - ", recs[i].block_in_disk);
+		else if (recs[i].len == 1) printf ("%d - ", recs[i].block_in_disk);
+		else printf ("%d..%d - ", recs[i].block_in_disk, recs[i].block_in_disk + recs[i].len - 1);
+	}
+	
+	for (int i = 0; depth > 0 && i < num; ++i) {
+		printf ("\n");
+		for (int j = 0; j < level; ++j) printf ("#");
+		printf (" %d : ", recs[i].block_in_disk);
+		ExtentNode* aux_node = (ExtentNode*) DiskDriver_getBlockPtr(disk, recs[i].block_in_disk, BLOCK_READ);
+		if (aux_node == NULL) continue;
+		AUX_print_extents(disk, aux_node->extents, aux_node->num_extents, aux_node->depth, level + 1);
+		DiskDriver_releaseBlock(disk, aux_node);
+	}
+}
+
 // Prints all blocks in a node
 void iNodeFS_printNodeBlocks(DiskDriver* disk, iNode* node) {
 	
 	if (node == NULL) return;
 	printf ("[ @ %d : ", node->header.block_in_disk);
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (node->file_blocks[i] != TBA) {
-			printf ("%d - ", node->file_blocks[i]);
-		}
-	}
-	
-	if (node->single_indirect != TBA) {
-		printf ("\n# %d : ", node->single_indirect);
-		iNode_indirect single_indirect;
-		DiskDriver_readBlock(disk, &single_indirect, node->single_indirect);
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (single_indirect.file_blocks[i] != TBA) {
-				printf ("%d - ", single_indirect.file_blocks[i]);
-			}
-		}
+	if (node->depth == INLINE) printf ("inline %lld bytes", (long long) node->num_entries);
+	else AUX_print_extents(disk, node->extents, node->num_extents, node->depth, 1);
+	printf (" ]\n");
+}
+
+// stores in name the name of node, searched in the entries of its parent directory ("/" for the top level one)
+// 0 on success, -1 if it's not found
+int iNodeFS_nodeName(iNodeFS* fs, iNode* node, char* name) {
+	if (fs == NULL || node == NULL) return TBA;
+	if (node->fcb.icb.directory_block == TBA) {
+		strcpy(name, "/");
+		return 0;
 	}
+	iNode* dir = AUX_iget(fs, node->fcb.icb.directory_block);
+	if (dir == NULL) return TBA;
 	
-	if (node->double_indirect != TBA) {
-		printf ("\n## %d : ", node->double_indirect);
-		iNode_indirect double_indirect;
-		DiskDriver_readBlock(disk, &double_indirect, node->double_indirect);
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (double_indirect.file_blocks[i] != TBA) {
-				printf ("%d - ", double_indirect.file_blocks[i]);
-			}
-		}
-		for (int i = 0; i < indirect_idx_size; ++i) {
-			if (double_indirect.file_blocks[i] != TBA) {
-				iNode_indirect nod;
-				printf ("\n### %d : ", double_indirect.file_blocks[i]);
-				DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-				for (int j = 0; j < indirect_idx_size; ++j) {
-					if (nod.file_blocks[j] != TBA) {
-						printf ("%d - ", nod.file_blocks[j]);
-					}
-				}
+	// The DirectoryBlocks are read in place in the map
+	int ret = TBA;
+	DirectoryEntry* entry = NULL;
+	for (int i = 0; ret == TBA; ++i) {
+		int voyager = AUX_file_block(fs->disk, dir, i, TBA, READ);
+		if (voyager == TBA) break;
+		DirectoryBlock* aux_db = (DirectoryBlock*) DiskDriver_getBlockPtr(fs->disk, voyager, BLOCK_READ);
+		if (aux_db == NULL) break;
+		for (int offset = 0; offset < DB_ENTRIES_SIZE(fs->disk); offset += entry->rec_len) {
+			entry = (DirectoryEntry*) (aux_db->entries + offset);
+			if (entry->rec_len == 0) break;
+			if (entry->block_in_disk == node->header.block_in_disk) {
+				memcpy(name, entry->name, entry->name_len);
+				name[entry->name_len] = '\0';
+				ret = 0;
+				break;
 			}
 		}
+		DiskDriver_releaseBlock(fs->disk, aux_db);
 	}
 	
-	printf (" ]\n");
+	AUX_iput(fs, dir);
+	return ret;
 }
 
 // removes the file in the current directory
@@ -2816,693 +2620,74 @@ int iNodeFS_remove(DirectoryHandle* d, char* filename) {
 	if (d == NULL) return TBA;
 	if (d->infs == NULL) return TBA;
 	DiskDriver* disk = d->infs->disk;
-	if (d == NULL) return TBA;
-	
-	// duplicating dirhandle
-	DirectoryHandle* daux = AUX_duplicate_dirhandle(d);
-	daux->indirect = NULL;
-	daux->current_block = &(daux->dcb->header);
-	daux->pos_in_node = 0;
-	daux->pos_in_block = 0;
+	if (disk == NULL) return TBA;
 	
-	// Creating an iNode to store what I need
-	iNode* aux_node = (iNode*) malloc(sizeof(iNode));
-	int snorlax = TBA;
-	int ret = TBA;
+	// Searching the entry (file or directory) in d
+	int entry_block = TBA;
+	int entry_offset = TBA;
+	int voyager = AUX_cached_lookup(d->infs, d->dcb, filename, ANY, &entry_block, &entry_offset);
+	if (voyager == TBA) return TBA;
 	
-	// Start research
-	// main inode
-	for (int i = 0; i < inode_idx_size; ++i) {
-		if (d->dcb->file_blocks[i] != TBA) {
-			snorlax = DiskDriver_readBlock(disk, aux_node, d->dcb->file_blocks[i]);
-			if (snorlax != TBA) {
-				if (strcmp(aux_node->fcb.name, filename) == 0) {
-					// if FIL
-					if (aux_node->fcb.icb.node_type == FIL) {
-						
-						// Main node
-						for (int i = 0; i < inode_idx_size; ++i) {
-							if (aux_node->file_blocks[i] != TBA) {
-								ret = DiskDriver_freeBlock(disk, aux_node->file_blocks[i]);
-								if (ret == TBA) return TBA;
-								aux_node->file_blocks[i] = TBA;
-							}
-						}
-						// Update
-						snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}
-						
-						// Single indirect
-						if (aux_node->single_indirect != TBA) {
-							iNode_indirect single_indirect;
-							snorlax = DiskDriver_readBlock(disk, &single_indirect, aux_node->single_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size; ++i) {
-								if (single_indirect.file_blocks[i] != TBA) {
-									ret = DiskDriver_freeBlock(disk, single_indirect.file_blocks[i]);
-									if (ret == TBA) return TBA;
-									single_indirect.file_blocks[i] = TBA;
-								}
-							}
-							// Update single
-							snorlax = DiskDriver_writeBlock(disk, &single_indirect, single_indirect.header.block_in_disk);
-							if (snorlax == TBA) return TBA;		
-							ret = DiskDriver_freeBlock(disk, aux_node->single_indirect);
-							if (ret == TBA) return TBA;					
-						}
-						
-						// Double indirect
-						if (aux_node->double_indirect != TBA) {
-							iNode_indirect double_indirect;
-							snorlax = DiskDriver_readBlock(disk, &double_indirect, aux_node->double_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size; ++i) {
-								if (double_indirect.file_blocks[i] != TBA) {
-									iNode_indirect nod;
-									snorlax = DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-									if (snorlax == TBA) return TBA;
-									for (int j = 0; j < indirect_idx_size; ++j) {
-										if (nod.file_blocks[j] != TBA) {
-											ret = DiskDriver_freeBlock(disk, nod.file_blocks[j]);
-											if (ret == TBA) return TBA;
-											nod.file_blocks[j] = TBA;
-										}
-									}
-									// Update nod
-									snorlax = DiskDriver_writeBlock(disk, &nod, nod.header.block_in_disk);
-								}
-								ret = DiskDriver_freeBlock(disk, double_indirect.file_blocks[i]);
-								if (ret == TBA) return TBA;
-								double_indirect.file_blocks[i] = TBA;								
-							}
-							// Update double
-							snorlax = DiskDriver_writeBlock(disk, &double_indirect, double_indirect.header.block_in_disk);
-							ret = DiskDriver_freeBlock(disk, aux_node->double_indirect);
-							if (ret == TBA) return TBA;
-						}
-						
-						// delete the indirects and the inode
-						ret = DiskDriver_freeBlock(disk, aux_node->header.block_in_disk);
-						if (ret == TBA) return TBA;
-						
-						// Update d->dcb
-						d->dcb->file_blocks[i] = TBA;
-						d->dcb->num_entries -= 1;
-						snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}						
-						
-					}
-					// if DIR
-					else if (aux_node->fcb.icb.node_type == DIR) {
-						
-						ret = iNodeFS_changeDir(daux, aux_node->fcb.name);
-						if (ret == TBA) return TBA;
-						
-						char* names[aux_node->num_entries];
-						for (int i = 0; i < aux_node->num_entries; ++i) {
-							names[i] = (char*) calloc(NAME_SIZE, 0);
-						}
-						iNodeFS_readDir(names, daux);
-						
-						for (int i = 0; i < aux_node->num_entries; ++i) {
-							ret = iNodeFS_remove(daux, names[i]);
-							if (ret == TBA) return TBA;
-						}
-						
-						// Main node
-						for (int i = 0; i < inode_idx_size; ++i) {
-							if (aux_node->file_blocks[i] != TBA) {								
-								ret = DiskDriver_freeBlock(disk, aux_node->file_blocks[i]);
-								if (ret == TBA) return TBA;
-								aux_node->file_blocks[i] = TBA;
-							}
-						}
-						
-						// Update
-						snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}
-						
-						// Single indirect
-						if (aux_node->single_indirect != TBA) {
-							iNode_indirect single_indirect;
-							snorlax = DiskDriver_readBlock(disk, &single_indirect, aux_node->single_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size; ++i) {
-								if (single_indirect.file_blocks[i] != TBA) {
-									ret = DiskDriver_freeBlock(disk, single_indirect.file_blocks[i]);
-									if (ret == TBA) return TBA;
-								}
-							}
-							// Update single
-							snorlax = DiskDriver_writeBlock(disk, &single_indirect, single_indirect.header.block_in_disk);
-							if (snorlax == TBA) return TBA;
-							ret = DiskDriver_freeBlock(disk, aux_node->single_indirect);
-							if (ret == TBA) return TBA;
-						}
-						
-						// Double indirect
-						if (aux_node->double_indirect != TBA) {
-							iNode_indirect double_indirect;
-							snorlax = DiskDriver_readBlock(disk, &double_indirect, aux_node->double_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size;++i) {
-								if (double_indirect.file_blocks[i] != TBA) {
-									iNode_indirect nod;
-									snorlax = DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-									if (snorlax == TBA) return TBA;
-									for (int j = 0; j < indirect_idx_size; ++j) {
-										if (nod.file_blocks[j] != TBA) {
-											ret = DiskDriver_freeBlock(disk, nod.file_blocks[j]);
-											if (ret == TBA) return TBA;
-											nod.file_blocks[j] = TBA;
-										}
-									}
-									// update nod
-									snorlax = DiskDriver_writeBlock(disk, &nod, nod.header.block_in_disk);
-									if (snorlax == TBA) {
-										printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-										// Freeing memory
-										daux = NULL;
-										free (daux);
-										aux_node = NULL;
-										free (aux_node);
-										return TBA;
-									}
-								}
-								ret = DiskDriver_freeBlock(disk, double_indirect.file_blocks[i]);
-								if (ret == TBA) return TBA;
-								double_indirect.file_blocks[i] = TBA;
-							}
-							// Update double
-							snorlax = DiskDriver_writeBlock(disk, &double_indirect, double_indirect.header.block_in_disk);
-							ret = DiskDriver_freeBlock(disk, aux_node->double_indirect);
-							if (ret == TBA) return TBA;
-						}
-						
-						
-						// Freeing aux_node and updating d->dcb
-						ret = DiskDriver_freeBlock(disk, aux_node->header.block_in_disk);
-						if (ret == TBA) return TBA;
-						
-						d->dcb->file_blocks[i] = TBA;
-						d->dcb->num_entries -= 1;
-						snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}				
-						
-					}
-					else return TBA;
-				}
-			}
-			else {
-				printf ("ERROR READING @ iNodeFS_remove()");
-				
-				// Freeing memory
-				aux_node = NULL;
-				free (aux_node);
-				
-				return TBA;
-			}
+	// Getting its iNode from the cache
+	iNode* aux_node = AUX_iget(d->infs, voyager);
+	if (aux_node == NULL) {
+		printf ("ERROR READING @ iNodeFS_remove()\n");
+		return TBA;
+	}
+	int ret = 0;
+	
+	// if DIR, removing all its content first
+	if (aux_node->fcb.icb.node_type == DIR) {
+		DirectoryHandle daux_handle = *d;
+		DirectoryHandle* daux = &daux_handle;
+		daux->directory = d->dcb;
+		daux->dcb = aux_node;
+		daux->current_block = &(aux_node->header);
+		
+		int num_entries = aux_node->num_entries;
+		char* names[num_entries];
+		for (int i = 0; i < num_entries; ++i) {
+			names[i] = (char*) calloc(NAME_SIZE, sizeof(char));
+		}
+		int num_read = iNodeFS_readDir(names, daux);
+		
+		for (int i = 0; i < num_read; ++i) {
+			if (iNodeFS_remove(daux, names[i]) == TBA) ret = TBA;
+		}
+		
+		// Freeing memory
+		for (int i = 0; i < num_entries; ++i) {
+			free (names[i]);
+		}
+		if (ret == TBA) {
+			printf ("ERROR REMOVING THE CONTENT OF %s @ iNodeFS_remove()\n", filename);
+			AUX_iput(d->infs, aux_node);
+			return TBA;
 		}
 	}
 	
-	// Single indirect
-	if (d->dcb->single_indirect == TBA) return 0;
-	iNode_indirect s_indirect;
-	snorlax = DiskDriver_readBlock(disk, &s_indirect, d->dcb->single_indirect);
-	if (snorlax == TBA) return TBA;
-	for (int i = 0; i < indirect_idx_size; ++i) {
-		if (s_indirect.file_blocks[i] != TBA) {
-			snorlax = DiskDriver_readBlock(disk, aux_node, s_indirect.file_blocks[i]);
-			if (snorlax != TBA) {
-				if (strcmp(aux_node->fcb.name, filename) == 0) {
-					// if FIL
-					if (aux_node->fcb.icb.node_type == FIL) {
+	// Freeing the blocks and the node
+	ret = AUX_free_node_blocks(disk, aux_node);
+	if (ret != TBA) ret = AUX_inode_free(d->infs, voyager);
+	if (ret == TBA) {
+		printf ("ERROR FREEING BLOCKS @ iNodeFS_remove()\n");
 		
-						// Main node
-						for (int i = 0; i < inode_idx_size; ++i) {
-							if (aux_node->file_blocks[i] != TBA) {
-								ret = DiskDriver_freeBlock(disk, aux_node->file_blocks[i]);
-								if (ret == TBA) return TBA;
-								aux_node->file_blocks[i] = TBA;
-							}
-						}
-						// Update
-						snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}
-						
-						// Single indirect
-						if (aux_node->single_indirect != TBA) {
-							iNode_indirect single_indirect;
-							snorlax = DiskDriver_readBlock(disk, &single_indirect, aux_node->single_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size; ++i) {
-								if (single_indirect.file_blocks[i] != TBA) {
-									ret = DiskDriver_freeBlock(disk, single_indirect.file_blocks[i]);
-									if (ret == TBA) return TBA;
-									single_indirect.file_blocks[i] = TBA;
-								}
-							}
-							// Update single
-							snorlax = DiskDriver_writeBlock(disk, &single_indirect, single_indirect.header.block_in_disk);
-							if (snorlax == TBA) return TBA;		
-							ret = DiskDriver_freeBlock(disk, aux_node->single_indirect);
-							if (ret == TBA) return TBA;					
-						}
-						// Double indirect
-						if (aux_node->double_indirect != TBA) {
-							iNode_indirect double_indirect;
-							snorlax = DiskDriver_readBlock(disk, &double_indirect, aux_node->double_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size; ++i) {
-								if (double_indirect.file_blocks[i] != TBA) {
-									iNode_indirect nod;
-									snorlax = DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-									if (snorlax == TBA) return TBA;
-									for (int j = 0; j < indirect_idx_size; ++j) {
-										if (nod.file_blocks[j] != TBA) {
-											ret = DiskDriver_freeBlock(disk, nod.file_blocks[j]);
-											if (ret == TBA) return TBA;
-											nod.file_blocks[j] = TBA;
-										}
-									}
-									// Update nod
-									snorlax = DiskDriver_writeBlock(disk, &nod, nod.header.block_in_disk);
-								}
-								ret = DiskDriver_freeBlock(disk, double_indirect.file_blocks[i]);
-								if (ret == TBA) return TBA;
-								double_indirect.file_blocks[i] = TBA;								
-							}
-							// Update double
-							snorlax = DiskDriver_writeBlock(disk, &double_indirect, double_indirect.header.block_in_disk);
-							ret = DiskDriver_freeBlock(disk, aux_node->double_indirect);
-							if (ret == TBA) return TBA;
-						}
-						
-						// delete the indirects and the inode
-						ret = DiskDriver_freeBlock(disk, aux_node->header.block_in_disk);
-						if (ret == TBA) return TBA;
-						
-						// Update s_indirect and d->dcb
-						s_indirect.file_blocks[i] = TBA;
-						snorlax = DiskDriver_writeBlock(disk, &s_indirect, s_indirect.header.block_in_disk);
-						if (snorlax == TBA) return TBA;
-						d->dcb->num_entries -= 1;
-						snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}						
-					}
-					
-					// if DIR
-					else if (aux_node->fcb.icb.node_type == DIR) {
-						
-						ret = iNodeFS_changeDir(daux, aux_node->fcb.name);
-						if (ret == TBA) return TBA;
-						
-						char* names[aux_node->num_entries];
-						for (int i = 0; i < aux_node->num_entries; ++i) {
-							names[i] = (char*) calloc(NAME_SIZE, 0);
-						}
-						iNodeFS_readDir(names, daux);
-						
-						for (int i = 0; i < aux_node->num_entries; ++i) {
-							ret = iNodeFS_remove(daux, names[i]);
-							if (ret == TBA) return TBA;
-						}
-						
-						// Main node
-						for (int i = 0; i < inode_idx_size; ++i) {
-							if (aux_node->file_blocks[i] != TBA) {								
-								ret = DiskDriver_freeBlock(disk, aux_node->file_blocks[i]);
-								if (ret == TBA) return TBA;
-								aux_node->file_blocks[i] = TBA;
-							}
-						}
-						// Update
-						snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}
-						
-						// Single indirect
-						if (aux_node->single_indirect != TBA) {
-							iNode_indirect single_indirect;
-							snorlax = DiskDriver_readBlock(disk, &single_indirect, aux_node->single_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size; ++i) {
-								if (single_indirect.file_blocks[i] != TBA) {
-									ret = DiskDriver_freeBlock(disk, single_indirect.file_blocks[i]);
-									if (ret == TBA) return TBA;
-								}
-							}
-							// Update single
-							snorlax = DiskDriver_writeBlock(disk, &single_indirect, single_indirect.header.block_in_disk);
-							if (snorlax == TBA) return TBA;
-							ret = DiskDriver_freeBlock(disk, aux_node->single_indirect);
-							if (ret == TBA) return TBA;
-						}
-						
-						// Double indirect
-						if (aux_node->double_indirect != TBA) {
-							iNode_indirect double_indirect;
-							snorlax = DiskDriver_readBlock(disk, &double_indirect, aux_node->double_indirect);
-							if (snorlax == TBA) return TBA;
-							
-							for (int i = 0; i < indirect_idx_size;++i) {
-								if (double_indirect.file_blocks[i] != TBA) {
-									iNode_indirect nod;
-									snorlax = DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-									if (snorlax == TBA) return TBA;
-									for (int j = 0; j < indirect_idx_size; ++j) {
-										if (nod.file_blocks[j] != TBA) {
-											ret = DiskDriver_freeBlock(disk, nod.file_blocks[j]);
-											if (ret == TBA) return TBA;
-											nod.file_blocks[j] = TBA;
-										}
-									}
-									// update nod
-									snorlax = DiskDriver_writeBlock(disk, &nod, nod.header.block_in_disk);
-									if (snorlax == TBA) {
-										printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-										// Freeing memory
-										daux = NULL;
-										free (daux);
-										aux_node = NULL;
-										free (aux_node);
-										return TBA;
-									}
-								}
-								ret = DiskDriver_freeBlock(disk, double_indirect.file_blocks[i]);
-								if (ret == TBA) return TBA;
-								double_indirect.file_blocks[i] = TBA;
-							}
-							// Update double
-							snorlax = DiskDriver_writeBlock(disk, &double_indirect, double_indirect.header.block_in_disk);
-							ret = DiskDriver_freeBlock(disk, aux_node->double_indirect);
-							if (ret == TBA) return TBA;
-						}
-						
-						// Freeing aux_node and updating s_indirect and d->dcb
-						ret = DiskDriver_freeBlock(disk, aux_node->header.block_in_disk);
-						if (ret == TBA) return TBA;
-						
-						s_indirect.file_blocks[i] = TBA;
-						snorlax = DiskDriver_writeBlock(disk, &s_indirect, s_indirect.header.block_in_disk);
-						if (snorlax == TBA) return TBA;
-						d->dcb->num_entries -= 1;
-						snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-						if (snorlax == TBA) {
-							printf ("ERROR WRITING @ iNodeFS_remove()\n");
-							
-							// Freeing memory
-							daux = NULL;
-							free (daux);
-							aux_node = NULL;
-							free (aux_node);
-							return TBA;
-						}
-						
-					}
-					else return TBA;
-					
-				}
-			}
-		}
+		// Freeing memory
+		AUX_iput(d->infs, aux_node);
+		return TBA;
 	}
 	
-	// Double indirect
-	if (d->dcb->double_indirect == TBA) return 0;
-	iNode_indirect d_indirect;
-	snorlax = DiskDriver_readBlock(disk, &d_indirect, d->dcb->double_indirect);
-	if (snorlax == TBA) return TBA;
-	for (int i = 0; i < indirect_idx_size; ++i) {
-		if (d_indirect.file_blocks[i] != TBA) {
-			iNode_indirect nod_indirect;
-			snorlax = DiskDriver_readBlock(disk, &nod_indirect, d_indirect.file_blocks[i]);
-			if (snorlax == TBA) return TBA;
-			for (int j = 0; j < indirect_idx_size; ++j) {
-				if (nod_indirect.file_blocks[j] != TBA) {
-					snorlax = DiskDriver_readBlock(disk, aux_node, nod_indirect.file_blocks[j]);
-					if (snorlax != TBA) {
-						if (strcmp(aux_node->fcb.name, filename) == 0) {
-							// if FIL
-							if (aux_node->fcb.icb.node_type == FIL) {
-								
-								// Main node
-								for (int i = 0; i < inode_idx_size; ++i) {
-									if (aux_node->file_blocks[i] != TBA) {
-										ret = DiskDriver_freeBlock(disk, aux_node->file_blocks[i]);
-										if (ret == TBA) return TBA;
-										aux_node->file_blocks[i] = TBA;
-									}
-								}
-								// Update
-								snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-								if (snorlax == TBA) return TBA;
-								
-								// Single indirect
-								if (aux_node->single_indirect != TBA) {
-									iNode_indirect single_indirect;
-									snorlax = DiskDriver_readBlock(disk, &single_indirect, aux_node->single_indirect);
-									if (snorlax == TBA) return TBA;
-									
-									for (int i = 0; i < indirect_idx_size; ++i) {
-										if (single_indirect.file_blocks[i] != TBA) {
-											ret = DiskDriver_freeBlock(disk, single_indirect.file_blocks[i]);
-											if (ret == TBA) return TBA;
-											single_indirect.file_blocks[i] = TBA;
-										}
-									}
-									// Update single
-									snorlax = DiskDriver_writeBlock(disk, &single_indirect, single_indirect.header.block_in_disk);
-									if (snorlax == TBA) return TBA;	
-									ret = DiskDriver_freeBlock(disk, aux_node->single_indirect);
-									if (ret == TBA) return TBA;								
-								}
-								// Double indirect
-								if (aux_node->double_indirect != TBA) {
-									iNode_indirect double_indirect;
-									snorlax = DiskDriver_readBlock(disk, &double_indirect, aux_node->double_indirect);
-									if (snorlax == TBA) return TBA;
-									
-									for (int i = 0; i < indirect_idx_size; ++i) {
-										if (double_indirect.file_blocks[i] != TBA) {
-											iNode_indirect nod;
-											snorlax = DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-											if (snorlax == TBA) return TBA;
-											for (int j = 0; j < indirect_idx_size; ++j) {
-												if (nod.file_blocks[j] != TBA) {
-													ret = DiskDriver_freeBlock(disk, nod.file_blocks[j]);
-													if (ret == TBA) return TBA;
-													nod.file_blocks[j] = TBA;
-												}
-											}
-											// Update nod
-											snorlax = DiskDriver_writeBlock(disk, &nod, nod.header.block_in_disk);
-										}
-										ret = DiskDriver_freeBlock(disk, double_indirect.file_blocks[i]);
-										if (ret == TBA) return TBA;
-										double_indirect.file_blocks[i] = TBA;
-									}
-									// Update double
-									snorlax = DiskDriver_writeBlock(disk, &double_indirect, double_indirect.header.block_in_disk);
-									ret = DiskDriver_freeBlock(disk, aux_node->double_indirect);
-									if (ret == TBA) return TBA;
-									
-								} // END aux_node research
-								
-								// Delete the indirects and the inode
-								ret = DiskDriver_freeBlock(disk, aux_node->header.block_in_disk);
-								if (ret == TBA) return TBA;
-								
-								// update nod_indirect and d->dcb
-								nod_indirect.file_blocks[j] = TBA;
-								snorlax = DiskDriver_writeBlock(disk, &nod_indirect, nod_indirect.header.block_in_disk);
-								if (snorlax == TBA) return TBA;
-								
-								d->dcb->num_entries -= 1;
-								snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-								if (snorlax == TBA) return TBA;
-								
-							}
-							// if DIR
-							else if (aux_node->fcb.icb.node_type == DIR) {
-								ret = iNodeFS_changeDir(daux, aux_node->fcb.name);
-								if (ret == TBA) return TBA;
-								
-								char* names[aux_node->num_entries];
-								for (int i = 0; i < aux_node->num_entries; ++i) {
-									names[i] = (char*) calloc(NAME_SIZE, 0);
-								}
-								iNodeFS_readDir(names, daux);
-								
-								for (int i = 0; i < aux_node->num_entries; ++i) {
-									ret = iNodeFS_remove(daux, names[i]);
-									if (ret == TBA) return TBA;
-								}
-								
-								// Main node
-								for (int i = 0; i < inode_idx_size; ++i) {
-									if (aux_node->file_blocks[i] != TBA) {								
-										ret = DiskDriver_freeBlock(disk, aux_node->file_blocks[i]);
-										if (ret == TBA) return TBA;
-										aux_node->file_blocks[i] = TBA;
-									}
-								}
-								// Update
-								snorlax = DiskDriver_writeBlock(disk, aux_node, aux_node->header.block_in_disk);
-								if (snorlax == TBA) return TBA;
-								
-								// Single indirect
-								if (aux_node->single_indirect != TBA) {
-									iNode_indirect single_indirect;
-									snorlax = DiskDriver_readBlock(disk, &single_indirect, aux_node->single_indirect);
-									if (snorlax == TBA) return TBA;
-									
-									for (int i = 0; i < indirect_idx_size; ++i) {
-										if (single_indirect.file_blocks[i] != TBA) {
-											ret = DiskDriver_freeBlock(disk, single_indirect.file_blocks[i]);
-											if (ret == TBA) return TBA;
-											single_indirect.file_blocks[i] = TBA;
-										}
-									}
-									// Update single
-									snorlax = DiskDriver_writeBlock(disk, &single_indirect, single_indirect.header.block_in_disk);
-									if (snorlax == TBA) return TBA;
-									ret = DiskDriver_freeBlock(disk, aux_node->single_indirect);
-									if (ret == TBA) return TBA;
-								}
-								
-								// Double indirect
-								if (aux_node->double_indirect != TBA) {
-									iNode_indirect double_indirect;
-									snorlax = DiskDriver_readBlock(disk, &double_indirect, aux_node->double_indirect);
-									if (snorlax == TBA) return TBA;
-									
-									for (int i = 0; i < indirect_idx_size;++i) {
-										if (double_indirect.file_blocks[i] != TBA) {
-											iNode_indirect nod;
-											snorlax = DiskDriver_readBlock(disk, &nod, double_indirect.file_blocks[i]);
-											if (snorlax == TBA) return TBA;
-											for (int j = 0; j < indirect_idx_size; ++j) {
-												if (nod.file_blocks[j] != TBA) {
-													ret = DiskDriver_freeBlock(disk, nod.file_blocks[j]);
-													if (ret == TBA) return TBA;
-													nod.file_blocks[j] = TBA;
-												}
-											}
-											// update nod
-											snorlax = DiskDriver_writeBlock(disk, &nod, nod.header.block_in_disk);
-											if (snorlax == TBA) {
-												printf ("ERROR WRITING @ iNodeFS_remove()\n");
-									
-												// Freeing memory
-												daux = NULL;
-												free (daux);
-												aux_node = NULL;
-												free (aux_node);
-												return TBA;
-											}
-										}
-										ret = DiskDriver_freeBlock(disk, double_indirect.file_blocks[i]);
-										if (ret == TBA) return TBA;
-										double_indirect.file_blocks[i] = TBA;
-									}
-									// Update double
-									snorlax = DiskDriver_writeBlock(disk, &double_indirect, double_indirect.header.block_in_disk);
-									ret = DiskDriver_freeBlock(disk, aux_node->double_indirect);
-									if (ret == TBA) return TBA;
-								} //END aux_node research
-								
-								// Delete  the indirects
-								ret = DiskDriver_freeBlock(disk, aux_node->header.block_in_disk);
-								if (ret == TBA) return TBA;
-								
-								// update nod_indirect and d->dcb
-								nod_indirect.file_blocks[j] = TBA;
-								snorlax = DiskDriver_writeBlock(disk, &nod_indirect, nod_indirect.header.block_in_disk);
-								if (snorlax == TBA) return TBA;
-								
-								d->dcb->num_entries -= 1;
-								snorlax = DiskDriver_writeBlock(disk, d->dcb, d->dcb->header.block_in_disk);
-								if (snorlax == TBA) return TBA;
-							}
-							else return TBA;
-						}
-					}
-				}
-			} // END nod_indirect, index j
-		}
-	} // END d_indirect, index i
+	// Updating d->dcb
+	ret = AUX_dir_remove(disk, d->dcb, entry_block, entry_offset);
 	
+	// The cached dentries of filename, and of its content if a DIR, are not valid anymore
+	AUX_dcache_invalidate(&d->infs->dcache, d->dcb->header.block_in_disk, filename);
+	if (aux_node->fcb.icb.node_type == DIR) AUX_dcache_invalidate_dir(&d->infs->dcache, voyager);
+	d->infs->dcache.generation += 1;
 	
-	return 0;
+	// The node can still be used by other handles, but it must not be written back
+	AUX_idrop(aux_node);
+	AUX_iput(d->infs, aux_node);
+	
+	return ret;
 }
@@ -2,24 +2,55 @@
 #include "disk_driver.c"
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
 
 // Node type
 #define NOD	-1
 #define FIL	 0
 #define DIR	 1
+#define ANY	 2		// only used in the searches: FIL or DIR
 
 // Stuffs
 #define FAULT		-1
 #define TBA			-1
 #define NAME_SIZE	128
 
-#define SINGLE		-1
-#define DOUBLE		-2
-#define DOUBLE_NOD -4
-
 #define READ		0
 #define WRITE		1
 
+// Hashed directory index
+#define DIR_INDEX_THRESHOLD	8		// DirectoryBlocks after which a directory gets indexed. 0 to never index
+#define DIR_INDEX_MIN		16		// buckets of a new index
+#define DIR_INDEX_MAX		4096	// buckets of the largest index
+
+// Dentry cache
+#define DCACHE_SIZE		256		// slots of the dentry cache
+#define PCACHE_SIZE		64		// slots of the path prefix cache
+#define PATH_SIZE		256		// longest path whose prefixes are cached
+
+// iNode cache
+#define ICACHE_BUCKETS	64		// buckets of the iNode cache
+
+// Write-back buffers
+#define WB_BLOCKS		64		// blocks of data buffered for a file before its blocks are allocated
+#define WB_CACHE_BLOCKS	1024	// blocks of data buffered for all the files before they're all placed on the disk
+
+// iNode table
+#define INODE_SIZE		256		// bytes of an iNode in the iNode table: at most BLOCK_SIZE_MIN
+#define INODE_RATIO		4		// blocks of the disk for each iNode of the table made by iNodeFS_format
+
+// Inline data
+#define INLINE_DATA		1		// new files keep their data in the iNode while it fits. 0 to never inline
+#define INLINE			-1		// depth of an iNode whose data is stored in place of its extents
+
+// Longest file: its blocks are numbered with an int
+#define FILE_MAX_BYTES(block_shift)	((int64_t) INT_MAX << (block_shift))
+
+// Preallocation flags (iNodeFS_fallocate)
+#define FALLOC_KEEP_SIZE	1		// the length of the file does not change, the blocks can be past its end
+#define FALLOC_LAZY_ZERO	2		// the blocks are not cleared now: they read as zeros until the file is written after them
+
 
 /********** INFO STRUCTURS **********/
 
@@ -33,19 +64,29 @@ typedef struct {
 
 // iNode Control Block
 typedef struct {
-	int directory_block;	// first node of the parent directory
-	int block_in_disk;		// repeated position of the block in the disk
+	int directory_block;	// iNode of the parent directory
+	int block_in_disk;		// repeated position of the block in the disk (for an iNode, its number)
 	int upper;				// index of the upper level node. TBA if it's a FIL or DIR
 	int node_type;			// NOD for node, FIL for file, DIR for dir
 } iNodeControlBlock;
 
 // File Control Block
 typedef struct {
-	int size_in_bytes;		// size in bytes. Multiple of BLOCK_SIZE
+	int64_t size_in_bytes;	// size in bytes. Multiple of the block size
 	int size_in_blocks;		// how many blocks this file occupy on the disk
 	iNodeControlBlock icb;	// ICB. It's null if we are in a upper level node
-	char name[NAME_SIZE];	// name of the file
-} FileControlBlock;
+} FileControlBlock;		// the name of the file is only in its DirectoryEntry
+
+// Extent
+// A run of blocks of a file that are contiguous on the disk too: the blocks of the file
+// from block_in_file to block_in_file + len - 1 are the ones of the disk from block_in_disk on.
+// In the index records of an extent tree len is not used, and block_in_disk is the ExtentNode
+// that maps the blocks of the file from block_in_file on
+typedef struct {
+	int block_in_file;		// first block of the run in the file
+	int block_in_disk;		// first block of the run in the disk
+	int len;				// blocks of the run
+} Extent;
 
 /* These two structures are contained in a node. A node has:
  * a header in which to store node's informations
@@ -56,68 +97,185 @@ typedef struct {
 
 /********** iNODE STRUCT **********/
 
+/* The size of a block is chosen when the disk is created: these structs (and the
+ * block structs) describe only the first part of a block, the array at their end
+ * fills what's left of it. So they're used only through pointers to block-sized
+ * memory (the disk, the iNode cache, the scratch pool), never as local variables.
+ * An iNode is the same, on INODE_SIZE bytes instead of a block.
+*/
+
 // Node.
-// Can be a FIL, or a DIR
+// Can be a FIL, or a DIR. It's packed with the others in the iNode table, and it's known by its
+// number there: header.block_in_disk and icb.block_in_disk are that number, not a block
 // Note that if it's type is NOD, then the node is a sub-level node. It's upper level node is in fcb.upper
 typedef struct {
 	BlockHeader header;
-	FileControlBlock fcb;
-	int num_entries;
-	int single_indirect;						// A node that stores blocks
-	int double_indirect;						// A node that stores nodes that store blocks
-	int file_blocks[ (BLOCK_SIZE
-			-sizeof(BlockHeader)
-			-sizeof(FileControlBlock)
-			-sizeof(int)
-			-sizeof(int)
-			-sizeof(int)) / sizeof(int) ];	
+	int index_buckets;							// DIR : number of buckets of the hashed index, 0 if not indexed
+	FileControlBlock fcb;						// (index_buckets keeps it 8 bytes aligned)
+	int64_t num_entries;						// FIL : length of the file in bytes. DIR : number of files
+	int64_t valid_bytes;						// FIL : bytes from the start of the file that were written. The blocks
+												// after them (preallocated) can hold old data: they read as zeros
+	int depth;									// levels of ExtentNodes under the iNode. 0 : extents are the file's runs
+												// INLINE (FIL) : no extents, the data of the file is stored in their place
+	int num_extents;							// records used in extents
+	Extent extents[];							// INODE_EXT_SIZE records sorted on block_in_file: up to INODE_SIZE
 } iNode;
 
-// Indirect Node.
-// Type NOD 
+// Extent Node.
+// Type NOD. A node of the extent tree (a B-tree on block_in_file) of a FIL or a DIR,
+// used once the records don't fit in the iNode. Its upper in the icb is the iNode
 typedef struct {
 	BlockHeader header;
 	iNodeControlBlock icb;
-	int num_entries;
-	int file_blocks[ (BLOCK_SIZE
-			-sizeof(BlockHeader)
-			-sizeof(iNodeControlBlock)
-			-sizeof(int)) / sizeof(int) ];
-} iNode_indirect;
+	int depth;				// 0 : a leaf, its records are runs of the file. Else index records
+	int num_extents;		// records used in extents
+	Extent extents[];		// NODE_EXT_SIZE records sorted on block_in_file: up to the end of the block
+} ExtentNode;
+
+
+// Super Block
+// Stored at the start of the first block of the disk. It's followed by the bitmap of the iNodes
+// in use and by the iNode table, where the iNodes are packed INODE_SIZE bytes each
+typedef struct {
+	int inode_size;			// bytes of an iNode in the table
+	int num_inodes;			// iNodes in the table
+	int free_inodes;		// iNodes not in use
+	int bitmap_start;		// first block of the bitmap of the iNodes
+	int bitmap_blocks;		// blocks of the bitmap of the iNodes
+	int table_start;		// first block of the iNode table
+	int table_blocks;		// blocks of the iNode table
+	int data_start;			// first block after the table, where the data goes
+	int inodes_per_group;	// the iNodes from g * inodes_per_group on keep their blocks in the allocation group g
+} SuperBlock;
 
 
 /********** BLOCK STRUCTS *********/
 
+// Directory Entry
+// Stores the name of a file together with the index of its iNode, so a search does not read the iNodes.
+// Entries have variable length and follow one another in the DirectoryBlock: rec_len is the
+// distance from the next one. The last entry of a block covers the rest of it
+typedef struct {
+	int block_in_disk;		// iNode of the file. TBA if the entry is free
+	uint32_t hash;			// hash of the name, compared before the name itself
+	uint16_t rec_len;		// length of the entry, its name and the free space after it
+	uint8_t name_len;		// length of the name (not NUL terminated)
+	int8_t node_type;		// FIL or DIR
+	char name[];
+} DirectoryEntry;
+
+// space taken by an entry with a name of name_len chars, aligned to 4 bytes
+#define DIR_ENTRY_SIZE(name_len) ((sizeof(DirectoryEntry) + (name_len) + 3) & ~3)
+
 // Directory Block
-// Stores an array of int that are iNode indexes
+// Stores a list of DirectoryEntry
+// In an indexed directory the first index_buckets blocks are the buckets of the hash index:
+// a name goes in the bucket hash % index_buckets, or in its chain of overflow blocks
 typedef struct {
 	BlockHeader header;
-	int file_blocks[ (BLOCK_SIZE
-			-sizeof(BlockHeader)) / sizeof(int) ];
+	int next;				// indexed DIR : block in file of the next block of the bucket. TBA if last
+	char entries[];			// DB_ENTRIES_SIZE bytes: up to the end of the block
 } DirectoryBlock;
 
 // File Block
-// Stores an array of char, that is the content of the file
-typedef struct {
-	BlockHeader header;
-	char data[ BLOCK_SIZE - sizeof(BlockHeader) ];
-} FileBlock;
+// Stores an array of char, that is the content of the file. It has no header:
+// the whole block is content, so a block is aligned to
+// its size both on the disk and in the file, and the offsets in the file are shifts.
+// The block is known only by the extents of its iNode
 
 
 /********** MANAGEMENT STUFFS **********/
 
+// Dentry
+// The result of a search of a name in a directory. If block_in_disk is TBA the name is not there
+typedef struct {
+	int dir_block;					// block of the directory's iNode. TBA if the dentry is empty
+	int index_buckets;				// index_buckets of the directory when cached (entry positions depend on it)
+	int node_type;					// type searched: FIL, DIR or ANY
+	int block_in_disk;				// iNode of the file, TBA for a negative dentry
+	int entry_block;				// DirectoryBlock of the entry
+	int entry_offset;				// offset of the entry in its DirectoryBlock
+	uint32_t hash;					// hash of the name
+	char name[NAME_SIZE];
+} Dentry;
+
+// Path Prefix
+// A prefix of a path, up to a '/', and the directory it leads to
+typedef struct {
+	int block_in_disk;				// iNode of the directory. TBA if the prefix is empty
+	int generation;					// generation of the cache when cached
+	uint32_t hash;					// hash of the prefix
+	int len;						// length of the prefix
+	char path[PATH_SIZE];
+} PathPrefix;
+
+// Dentry Cache
+// Direct mapped on (directory, name, type): a new dentry replaces the one in its slot
+// The path prefixes are direct mapped on their hash. They're all dropped (by a new generation)
+// on every remove, since any of them could pass through the removed directory
+typedef struct {
+	Dentry dentries[DCACHE_SIZE];
+	PathPrefix prefixes[PCACHE_SIZE];
+	int generation;
+	int hits;
+	int misses;
+	int prefix_hits;
+} DentryCache;
+
+// Cached iNode
+// The copy of an iNode shared by all the handles that use it. Handles point to node,
+// and it's converted back to its CachedNode by AUX_cached(). node is INODE_SIZE bytes, so it's the last field
+typedef struct CachedNode {
+	int refcount;					// handles (and functions) that are using node
+	int dirty;						// 1 if node has to be written back on the disk
+	int removed;					// 1 if the file was removed: node is never written back
+	char* wb_data;					// write-back buffer: bytes written in the file whose blocks are not allocated yet
+	int wb_cap;						// size of wb_data (kept when the node leaves the cache)
+	int wb_len;						// bytes in wb_data, 0 if there's nothing to place on the disk
+	int64_t wb_start;				// offset in the file of the first byte in wb_data
+	int64_t wb_size;				// length of the file on the disk, before the buffer was filled
+	struct CachedNode* next;		// next node in the bucket
+	iNode node;
+} CachedNode;
+
+// iNode Cache
+// Hash table of the iNodes in use, on their block in disk. A node leaves the cache
+// (written back if dirty) when its last reference is dropped
+typedef struct {
+	CachedNode* buckets[ICACHE_BUCKETS];
+	CachedNode* free_nodes;			// nodes that left the cache, kept to be reused
+	int cached;						// nodes in the cache
+	int64_t wb_bytes;				// bytes in the write-back buffers of the nodes
+	int hits;
+	int misses;
+} iNodeCache;
+
+// Scratch Pool
+// Block-sized buffers and file handles given back by their users, kept for the next ones
+// instead of being freed. Free objects are linked through their first bytes
+typedef struct {
+	void* free_blocks;				// list of free block-sized buffers
+	void* free_handles;				// list of free FileHandles
+	int blocks;						// block-sized buffers allocated
+	int handles;					// FileHandles allocated
+} ScratchPool;
+
 // File System struct
 typedef struct {
 	DiskDriver* disk;
+	SuperBlock* super;				// in place in the map
+	BitMap ibmap;					// bitmap of the iNodes in use, in place in the map
+	DentryCache dcache;				// shared by all the handles of the file system
+	iNodeCache icache;				// shared by all the handles of the file system
+	ScratchPool pool;				// shared by all the handles of the file system
 } iNodeFS;
 
 // Directory Handle
 // Stores all key informations about the current directory
 typedef struct {
 	iNodeFS* infs;					// pointer to memory file system struct
-	iNode* dcb;						// pointer to the main iNode of the directory
-	iNode* directory;				// pointer to the parent directory (null if top level)
-	iNode_indirect* indirect;		// pointer to the current node in the file. Only used if we are in an indexed node
+	iNode* dcb;						// pointer to the main iNode of the directory (in the iNode cache)
+	iNode* directory;				// pointer to the parent directory (in the iNode cache, null if top level)
 	BlockHeader* current_block;		// current block in the directory
 	int pos_in_node;				// cursor position in the iNode's index list
 	int pos_in_block;				// relative position of the cursor in the DirectoryBlock
@@ -127,30 +285,20 @@ typedef struct {
 // Used to refer to open files
 typedef struct {
 	iNodeFS* infs;					// pointer to memory file system struct
-	iNode* fcb;						// pointer to the main iNode of the file
-	iNode* directory;				// pointer to the directory in where the file is stored
-	iNode_indirect* indirect;		// pointer to the current node in the file. Only used if we are in an indexed node
-	BlockHeader* current_block;		// current block in the file
-	int pos_in_node;				// cursor position in the iNode's index list
-	int pos_in_block;				// relative position of the cursor in the FileBlock
+	iNode* fcb;						// pointer to the main iNode of the file (in the iNode cache)
+	iNode* directory;				// pointer to the directory in where the file is stored (in the iNode cache, null if opened by path)
+	int64_t pos_in_file;			// position of the cursor in the file, in bytes
 } FileHandle;
 
 
 /********** SOME SIZES **********/
 
-int inode_idx_size = (BLOCK_SIZE
-			-sizeof(BlockHeader)
-			-sizeof(FileControlBlock)
-			-sizeof(int)
-			-sizeof(int)
-			-sizeof(int)) / sizeof(int);
-int indirect_idx_size = (BLOCK_SIZE
-			-sizeof(BlockHeader)
-			-sizeof(iNodeControlBlock)
-			-sizeof(int)) / sizeof(int);
-int DB_idx_size = (BLOCK_SIZE
-			-sizeof(BlockHeader)) / sizeof(int);
-int FB_text_size = BLOCK_SIZE - sizeof(BlockHeader);
+// Sizes of the file system. The iNodes are INODE_SIZE bytes on every disk, the other sizes depend on the
+// block size of the disk, so they're computed from it: every mounted file system has its own
+#define INODE_EXT_SIZE				((int) ((INODE_SIZE - offsetof(iNode, extents)) / sizeof(Extent)))
+#define INODE_INLINE_SIZE			((int) (INODE_SIZE - offsetof(iNode, extents)))
+#define NODE_EXT_SIZE(disk)			((int) (((disk)->block_size - offsetof(ExtentNode, extents)) / sizeof(Extent)))
+#define DB_ENTRIES_SIZE(disk)		((int) ((disk)->block_size - offsetof(DirectoryBlock, entries)))
 
 
 /********** FILE SYSTEM'S FUNCTIONS **********/
@@ -164,17 +312,187 @@ DirectoryHandle* iNodeFS_init(iNodeFS* fs, DiskDriver* disk);
 // it also clears the bitmap of occupied blocks on the disk
 // the current_directory_block is cached in the iNodeFS struct
 // and set to the top level directory
+// the iNode table has an iNode for every INODE_RATIO blocks
 void iNodeFS_format(iNodeFS* fs);
 
-// Duplicates a directory handle
-DirectoryHandle* AUX_duplicate_dirhandle(DirectoryHandle* d);
+// same as iNodeFS_format, with an iNode table of (at least) num_inodes iNodes
+void iNodeFS_formatInodes(iNodeFS* fs, int num_inodes);
+
+// reads the SuperBlock of the disk of fs and sets the iNode table of fs on it
+// returns 0 on success, -1 if the disk is not formatted
+int AUX_itable_mount(iNodeFS* fs);
+
+// returns the address of the iNode number ino in the table, pinned in the map
+// returns NULL if ino is not in the table
+iNode* AUX_inode_slot(iNodeFS* fs, int ino);
+
+// copies the iNode number ino from the table to dest
+// returns 0 on success, -1 if ino is not in use
+int AUX_inode_read(iNodeFS* fs, int ino, iNode* dest);
+
+// copies node in its slot of the table (the one of its number, in header.block_in_disk)
+// returns 0 on success, -1 on error
+int AUX_inode_write(iNodeFS* fs, iNode* node);
 
-// Duplicates a file handle
-FileHandle* AUX_duplicate_filehandle(FileHandle* f);
+// takes a free iNode from the table, the first one from hint on (wrapping around)
+// returns its number, -1 if the table is full
+int AUX_inode_alloc(iNodeFS* fs, int hint);
 
-// puts the directoryhandle at the right place in the inode with side effect
-// mode == READ or WRITE
-void AUX_indirect_dir_management (DirectoryHandle* d, int mode);
+// gives back to the table the iNode number ino
+// returns 0 on success, -1 on error
+int AUX_inode_free(iNodeFS* fs, int ino);
+
+// returns the block from which the blocks of node are placed:
+// the start of the allocation group of its iNode (after the iNode table)
+int AUX_node_hint(iNodeFS* fs, iNode* node);
+
+// returns the free iNodes of the allocation group group, counted on the bitmap of the iNodes
+int AUX_group_free_inodes(iNodeFS* fs, int group);
+
+// returns the first iNode of the allocation group where a new directory under parent goes:
+// among the groups with at least the average free iNodes, the one with the most free blocks,
+// so that the directories are spread on the disk and their files have room near them
+int AUX_dir_group(iNodeFS* fs, iNode* parent);
+
+// splits the position pos in a file in its block in file and its position in that block.
+// The block size is a power of two, so it's a shift and a mask
+void AUX_locate(DiskDriver* disk, int64_t pos, int* block_in_file, int* pos_in_block);
+
+// empties the scratch pool (without freeing what's in it)
+void AUX_pool_init(ScratchPool* pool);
+
+// returns a block-sized buffer from the scratch pool of fs, allocating it only if the pool is empty
+void* AUX_scratch_get(iNodeFS* fs);
+
+// gives back to the scratch pool of fs a buffer returned by AUX_scratch_get
+void AUX_scratch_put(iNodeFS* fs, void* block);
+
+// returns a FileHandle from the scratch pool of fs, allocating it only if the pool is empty
+FileHandle* AUX_handle_get(iNodeFS* fs);
+
+// gives back to the scratch pool of fs a FileHandle returned by AUX_handle_get
+void AUX_handle_put(iNodeFS* fs, FileHandle* f);
+
+// frees the buffers and the FileHandles kept in the scratch pool, and empties it
+void AUX_pool_free(ScratchPool* pool);
+
+// empties the iNode cache and resets its counters
+void AUX_icache_init(iNodeCache* ic);
+
+// frees the nodes of the iNode cache, the ones in use and the free ones, with their write-back buffers,
+// and empties it. The nodes are not written back
+void AUX_icache_free(iNodeCache* ic);
+
+// returns the CachedNode of a cached iNode
+CachedNode* AUX_cached(iNode* node);
+
+// returns the cached iNode number ino, reading it from the table if it's not in the cache
+// it takes a reference to the node, to be dropped with AUX_iput
+// returns null on error
+iNode* AUX_iget(iNodeFS* fs, int ino);
+
+// takes another reference to a cached iNode
+void AUX_iref(iNode* node);
+
+// drops a reference to a cached iNode. When it's the last one, its write-back buffer is placed on the disk,
+// the node is written back (if dirty) and leaves the cache, kept in its free list.
+// A removed node gives back the blocks it still has
+// returns 0 on success, -1 on error
+int AUX_iput(iNodeFS* fs, iNode* node);
+
+// marks a cached iNode as modified: it's written back when it leaves the cache or at iNodeFS_sync
+void AUX_idirty(iNode* node);
+
+// marks a cached iNode as removed from the disk: it's never written back
+void AUX_idrop(iNode* node);
+
+// writes back on the disk all the write-back buffers and all the modified iNodes in the cache
+// returns 0 on success, -1 on error
+int iNodeFS_sync(iNodeFS* fs);
+
+// unmounts the file system fs: d (the handle returned by iNodeFS_init) gives back its iNodes and is freed,
+// everything is written back on the disk, and the memory of the caches and of the scratch pool is freed.
+// The FileHandles still open are not valid anymore. The disk stays mapped (see DiskDriver_unmap)
+// returns 0 on success, -1 on error
+int iNodeFS_unmount(iNodeFS* fs, DirectoryHandle* d);
+
+// returns the hash of a name (FNV-1a), stored in its DirectoryEntry
+uint32_t AUX_name_hash(const char* name);
+
+// initializes an empty DirectoryBlock: a single free entry that covers all of it
+void AUX_db_init(DiskDriver* disk, DirectoryBlock* db);
+
+// returns the number of DirectoryBlocks of dir, the end of its last extent
+// (a directory has no holes: its blocks are never freed while it exists)
+int AUX_dir_blocks(DiskDriver* disk, iNode* dir);
+
+// searches in the DirectoryBlock db the entry named name of type node_type (ANY for both)
+// returns its offset in db->entries, -1 if it's not there
+int AUX_db_search(DiskDriver* disk, DirectoryBlock* db, uint32_t hash, const char* name, int name_len, int node_type);
+
+// finds in the DirectoryBlock db a free entry of at least needed bytes,
+// splitting the slack of a used entry if there is no free one
+// returns the entry, with its rec_len set, or NULL if db is full
+DirectoryEntry* AUX_db_slot(DiskDriver* disk, DirectoryBlock* db, int needed);
+
+// searches the entry named name of type node_type (ANY for both) in the directory dir
+// only the DirectoryBlocks of dir are read, not the iNodes of its files. If dir is indexed
+// only the bucket of the name is read
+// if found, entry_block and entry_offset (if not NULL) are set to the position of the entry
+// returns the block of the entry's iNode, -1 if it does not exist
+int AUX_dir_lookup(DiskDriver* disk, iNode* dir, const char* name, int node_type, int* entry_block, int* entry_offset);
+
+// places in the directory dir an entry for the iNode in block_in_disk
+// unindexed: in the first DirectoryBlock with enough space, or in a new one
+// indexed: in the bucket of the name, or in a new overflow block of it
+// dir is updated only in memory (the caller writes it)
+// returns 0 on success, -1 on error
+int AUX_dir_insert(iNodeFS* fs, iNode* dir, const char* name, int node_type, int block_in_disk);
+
+// rebuilds the directory dir with a hashed index of the given number of buckets
+// (0 to go back to an unindexed directory), moving all its entries in new DirectoryBlocks
+// dir is updated only in memory (the caller writes it). On error it's left as it was
+// returns 0 on success, -1 on error
+int AUX_dir_reindex(iNodeFS* fs, iNode* dir, int buckets);
+
+// adds to the directory dir an entry for the iNode in block_in_disk
+// the directory gets indexed once it's larger than DIR_INDEX_THRESHOLD blocks,
+// and the index doubles its buckets once they have on average an overflow block
+// updates dir (written back by the iNode cache)
+// returns 0 on success, -1 on error
+int AUX_dir_add(iNodeFS* fs, iNode* dir, const char* name, int node_type, int block_in_disk);
+
+// empties the dentry cache and resets its counters
+void AUX_dcache_init(DentryCache* dc);
+
+// returns the slot of the dentry cache for the name with the given hash, searched in dir_block
+int AUX_dcache_slot(int dir_block, uint32_t hash, int node_type);
+
+// as AUX_dir_lookup, but the result is first searched in (and then stored in) the dentry cache of fs
+// negative results are cached too
+int AUX_cached_lookup(iNodeFS* fs, iNode* dir, const char* name, int node_type, int* entry_block, int* entry_offset);
+
+// drops from the dentry cache the dentries of name in the directory dir_block, of any type
+void AUX_dcache_invalidate(DentryCache* dc, int dir_block, const char* name);
+
+// drops from the dentry cache all the dentries of the directory dir_block
+void AUX_dcache_invalidate_dir(DentryCache* dc, int dir_block);
+
+// removes from the directory dir the entry at entry_offset in the DirectoryBlock entry_block
+// its space goes to the previous entry of the block
+// updates dir (written back by the iNode cache)
+// returns 0 on success, -1 on error
+int AUX_dir_remove(DiskDriver* disk, iNode* dir, int entry_block, int entry_offset);
+
+// frees the runs mapped by the num records recs of an extent tree's node of the given depth,
+// and the ExtentNodes under it
+// returns 0 on success, -1 on error
+int AUX_extent_free(DiskDriver* disk, Extent* recs, int num, int depth);
+
+// frees all the blocks of node (FileBlocks or DirectoryBlocks) and its ExtentNodes
+// the node itself is not freed: it's left with no extents and no blocks (or with no inline data)
+// returns 0 on success, -1 on error
+int AUX_free_node_blocks(DiskDriver* disk, iNode* node);
 
 // creates an empty file in the directory d
 // returns null on error (file existing, no free blocks)
@@ -188,26 +506,166 @@ int iNodeFS_readDir(char** names, DirectoryHandle* d);
 FileHandle* iNodeFS_openFile(DirectoryHandle* d, const char* filename);
 
 // closes a file handle (destroyes it)
+// its iNodes are given back to the cache, and written back if it was their last user
 // RETURNS 0 on success, -1 if fails
 int iNodeFS_close(FileHandle* f);
 
-// puts the filehandle at the right place in the inode with side effect
-// mode == READ or WRITE
-void AUX_indirect_management (FileHandle* f, int mode);
+// writes in the file fcb, from offset on, size bytes stored in data, allocating the missing
+// blocks in runs as long as the disk allows. Inline data is written in the iNode while it fits,
+// else it's moved out first. If offset is past the end of the file the gap
+// is filled with zeros. written is set to the bytes written, even when the disk gets full
+// returns 0 on success, -1 on error
+int AUX_file_write(iNodeFS* fs, iNode* fcb, void* data, int64_t size, int64_t offset, int64_t* written);
+
+// clears the bytes of fcb from from to to that are stored in its blocks (the ones not mapped read as zeros anyway)
+// returns 0 on success, -1 on error
+int AUX_file_zero(DiskDriver* disk, iNode* fcb, int64_t from, int64_t to);
+
+// writes in the file fcb, from offset on, size bytes stored in data, keeping them in its write-back buffer:
+// the blocks are allocated when the buffer is placed on the disk, all the buffered range at once.
+// The buffer is placed on the disk first if the write does not continue it or does not fit in it.
+// Inline data and writes larger than the buffer go straight to AUX_file_write.
+// written is set to the bytes written. A removed file is not written
+// returns 0 on success, -1 on error
+int AUX_wb_write(iNodeFS* fs, iNode* fcb, void* data, int64_t size, int64_t offset, int64_t* written);
+
+// places on the disk the write-back buffer of the cached iNode node, allocating its blocks.
+// The buffer of a removed file is dropped
+// returns 0 on success, -1 on error (the file is cut to what was placed on the disk)
+int AUX_wb_flush(iNodeFS* fs, iNode* node);
+
+// places on the disk the write-back buffers of all the iNodes in the cache
+// returns 0 on success, -1 on error
+int AUX_wb_flush_all(iNodeFS* fs);
+
+// copies over data (size bytes of the file node from offset on) the buffered bytes that fall in it
+void AUX_wb_overlay(iNode* node, char* data, int64_t offset, int64_t size);
+
+// places on the disk the bytes written in the file of f that are still in its write-back buffer
+// returns 0 on success, -1 on error
+int iNodeFS_flush(FileHandle* f);
 
 // writes in the file, at current position for size bytes stored in data
-// overwriting and allocating new space if necessary
-// returns the number of bytes written
-int iNodeFS_write(FileHandle* f, void* data, int size);
+// overwriting and allocating new space if necessary (when the write-back buffer is placed on the disk)
+// returns the number of bytes written, -1 on error (or if the file was removed while f was open)
+int64_t iNodeFS_write(FileHandle* f, void* data, int64_t size);
 
 // reads in the file, at current position size bytes and stores them in data
-// returns the number of bytes read
-int iNodeFS_read(FileHandle* f, void* data, int size);
+// returns the number of bytes read: less than size only at the end of the file
+int64_t iNodeFS_read(FileHandle* f, void* data, int64_t size);
 
 // returns the number of bytes read (moving the current pointer to pos)
 // returns pos on success
 // -1 on error (file too short)
-int iNodeFS_seek(FileHandle* f, int pos);
+int64_t iNodeFS_seek(FileHandle* f, int64_t pos);
+
+// returns the inline data of node (a FIL whose depth is INLINE): INODE_INLINE_SIZE bytes in place of its extents
+char* AUX_inline_data(iNode* node);
+
+// moves the inline data of node (a FIL) in a data block of its own, and gives node its extents back
+// node is updated only in memory (the caller writes it)
+// returns 0 on success, -1 if the disk is full
+int AUX_inline_move_out(iNodeFS* fs, iNode* node);
+
+// returns the position of the last record of recs (num sorted records) whose block_in_file
+// is not after block_in_file, -1 if there is none
+int AUX_extent_search(Extent* recs, int num, int block_in_file);
+
+// returns the block in disk that stores the block_in_file-th block of node (a FIL or a DIR),
+// searching its extent tree. run (if not NULL) is set to the blocks from that one on that
+// are contiguous on the disk too (the rest of its extent)
+// returns -1 if the block is not mapped: run is set to the blocks from that one on that are
+// not mapped either (at most, the next extent could be further)
+int AUX_extent_lookup(DiskDriver* disk, iNode* node, int block_in_file, int* run);
+
+// creates an empty ExtentNode of the given depth for node (a FIL or a DIR), placing it from hint on
+// node is updated only in memory (the caller writes it)
+// returns the new node, pinned in the map, NULL if the disk is full
+ExtentNode* AUX_extent_node(DiskDriver* disk, iNode* node, int depth, int hint);
+
+// places rec among the num sorted records recs of a node of the given depth, that has room for max.
+// If the node is full it's split: its upper half goes in a new ExtentNode, placed from hint on,
+// whose index record is stored in split
+// returns 0 on success, 1 if the node was split, -1 if the disk is full
+int AUX_extent_put(DiskDriver* disk, iNode* node, Extent* recs, int* num, int max, int depth, Extent rec, int hint, Extent* split);
+
+// adds the run rec to the subtree of the num sorted records recs of a node of the given depth,
+// that has room for max. rec is merged with the runs next to it when it continues them
+// returns 0 on success, 1 if the node was split (split is the index record of its new sibling),
+// -1 if the disk is full
+int AUX_extent_add(DiskDriver* disk, iNode* node, Extent* recs, int* num, int max, int depth, Extent rec, int hint, Extent* split);
+
+// makes room for a record in the iNode node before a change that could split its children:
+// if it's full its records go down in a new ExtentNode, placed from hint on, and the tree grows by a level
+// returns 0 on success, -1 if the disk is full
+int AUX_extent_grow(DiskDriver* disk, iNode* node, int hint);
+
+// maps the len blocks of node from block_in_file on (not mapped yet) to the ones of the disk
+// from block_in_disk on. The run is merged with the extents next to it when it continues them,
+// and the full ExtentNodes are split (or the tree grows by a level), placing the new ones from hint on
+// node is updated only in memory (the caller writes it)
+// returns 0 on success, -1 if the disk is full
+int AUX_extent_insert(DiskDriver* disk, iNode* node, int block_in_file, int block_in_disk, int len, int hint);
+
+// unmaps and frees the blocks from from to to (excluded) in the subtree of the num sorted records recs
+// of a node of the given depth, that has room for max. The ExtentNodes left empty are freed.
+// A run cut in the middle keeps its head and gets a new record for its tail, so the node can be split
+// returns 0 on success, 1 if the node was split (split is the index record of its new sibling), -1 on error
+int AUX_extent_cut(DiskDriver* disk, iNode* node, Extent* recs, int* num, int max, int depth, int from, int to, int hint, Extent* split);
+
+// unmaps and frees the blocks of node from from to to (excluded), and the ExtentNodes left empty.
+// Then the tree gets lower while the records of the only child of the iNode fit in it
+// node is updated only in memory (the caller writes it)
+// returns 0 on success, -1 on error
+int AUX_extent_remove(DiskDriver* disk, iNode* node, int from, int to, int hint);
+
+// returns the number of blocks of node up to the end of its last extent
+int AUX_extent_end(DiskDriver* disk, iNode* node);
+
+// returns the block in disk that stores the block_in_file-th block of fcb (a FIL or a DIR),
+// searching its extent tree without using any handle
+// mode == WRITE : a missing block is created, placing it (and the ExtentNodes) from hint on
+// returns -1 if the block does not exist (READ) or can't be created (WRITE)
+int AUX_file_block(DiskDriver* disk, iNode* fcb, int block_in_file, int hint, int mode);
+
+// reads size bytes of the file from offset on and stores them in data
+// it does not use nor move the current position of f
+// returns the number of bytes read: less than size only at the end of the file
+int64_t iNodeFS_pread(FileHandle* f, void* data, int64_t size, int64_t offset);
+
+// writes size bytes stored in data in the file, from offset on
+// overwriting and allocating new space if necessary (when the write-back buffer is placed on the disk).
+// If offset is past the end of the file the gap reads as zeros. It does not use nor move the current position of f
+// returns the number of bytes written, -1 on error (or if the file was removed while f was open)
+int64_t iNodeFS_pwrite(FileHandle* f, void* data, int64_t size, int64_t offset);
+
+// reserves the blocks of the file of f from offset on for len bytes, without writing them:
+// the missing ones are allocated in runs as long as the disk allows, and mapped by the extents in one pass.
+// The length of the file grows to offset + len, unless flags has FALLOC_KEEP_SIZE.
+// The blocks are cleared now, unless flags has FALLOC_LAZY_ZERO: then they're cleared when the file is
+// written after them, and until then they read as zeros
+// returns 0 on success, -1 on error (the disk is full, or the file was removed while f was open).
+// The runs allocated before the disk fills up stay in the file
+int iNodeFS_fallocate(FileHandle* f, int64_t offset, int64_t len, int flags);
+
+// sets the length of the file of f to new_size. A shorter file gives back all its blocks after new_size
+// (the preallocated ones too), a longer one reads as zeros after its old end, with no new blocks
+// returns 0 on success, -1 on error
+int iNodeFS_truncate(FileHandle* f, int64_t new_size);
+
+// clears len bytes of the file of f from offset on, giving back the blocks in the range:
+// they read as zeros, and the length of the file does not change
+// returns 0 on success, -1 on error
+int iNodeFS_punchHole(FileHandle* f, int64_t offset, int64_t len);
+
+// resolves an absolute path ("/a/b/c") and stores in out the block of its iNode
+// "." and ".." are allowed, and the walk starts from the longest prefix in the cache
+// it does not use any handle
+// 0 on success, -1 if the path does not exist
+int iNodeFS_lookupPath(iNodeFS* fs, const char* path, int* out);
+
+// opens the file at the given absolute path. The file should be existing
+FileHandle* iNodeFS_openPath(iNodeFS* fs, const char* path);
 
 // seeks for a directory in d. If dirname is equal to ".." it goes one level up
 // 0 on success, negative value on error
@@ -219,9 +677,24 @@ int iNodeFS_changeDir(DirectoryHandle* d, char* dirname);
 // -1 on error
 int iNodeFS_mkDir(DirectoryHandle* d, char* dirname);
 
+// converts the current directory of d to a hashed index with the given number of buckets
+// (at most DIR_INDEX_MAX), or back to an unindexed directory if buckets is 0.
+// On error (no room for the new blocks) the directory is left as it was
+// 0 on success
+// -1 on error
+int iNodeFS_indexDir(DirectoryHandle* d, int buckets);
+
+// Prints the blocks mapped by the num records recs of an extent tree's node of the given depth:
+// the runs of a leaf, then the ExtentNodes under an index node one per line, marked with level '#'
+void AUX_print_extents(DiskDriver* disk, Extent* recs, int num, int depth, int level);
+
 // Prints all blocks in a node
 void iNodeFS_printNodeBlocks(DiskDriver* disk, iNode* node);
 
+// stores in name the name of node, searched in the entries of its parent directory ("/" for the top level one)
+// 0 on success, -1 if it's not found
+int iNodeFS_nodeName(iNodeFS* fs, iNode* node, char* name);
+
 // removes the file in the current directory
 // returns -1 on failure 0 on success
 // if a directory, it removes recursively all contained files
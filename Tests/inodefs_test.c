@@ -2,6 +2,14 @@
 
 int main (int argc, char** argv) {
 	
+	// * * * * BITMAP KERNELS CHECK * * * *
+	
+	if (argc >= 2 && strcmp(argv[1], "bitmap") == 0) {
+		printf (BOLD_RED "\n* * * * BITMAP KERNELS CHECK * * * *\n" COLOR_RESET);
+		printf (YELLOW "\n\n**	Comparing the search kernels with the byte-wise scan - testing BitMap_get()\n\n" COLOR_RESET);
+		return (BitMap_checkKernels(BITMAP_ROUNDS) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	
 	// * * * * FILE SYSTEM INITIALIZATION * * * *
 	
 	printf (BOLD_RED "\n* * * * FILE SYSTEM INITIALIZATION * * * *\n"COLOR_RESET);
@@ -14,7 +22,7 @@ int main (int argc, char** argv) {
 	
 	iNodeFS fs;
 	DirectoryHandle* dirhandle;
-	FileHandle* filehandle;
+	FileHandle* filehandle = NULL;
 	dirhandle = iNodeFS_init(&fs, &disk);
 	
 	if (dirhandle == NULL) {
@@ -40,9 +48,11 @@ int main (int argc, char** argv) {
 		char* line = NULL;
 		
 		int ret = -1;
+		char dirname[NAME_SIZE];
 		
 		while (-TBA) {
-			printf (BOLD_YELLOW "g@g:~%s " COLOR_RESET, dirhandle->dcb->fcb.name);
+			iNodeFS_nodeName(&fs, dirhandle->dcb, dirname);
+			printf (BOLD_YELLOW "g@g:~%s " COLOR_RESET, dirname);
 			
 			getline(&line, &len, stdin);
 			sscanf(line, "%s %s", cmd1, cmd2);
@@ -51,31 +61,63 @@ int main (int argc, char** argv) {
 			if (strcmp(cmd1, SYS_SHOW) == 0 ){
 				iNodeFS_print(&fs, dirhandle);
 			}
+			else if (strcmp(cmd1, SYS_SYNC) == 0) {
+				int64_t wb_bytes = fs.icache.wb_bytes;
+				ret = iNodeFS_sync(&fs);
+				printf ("sync : %d - write-back bytes : %lld -> %lld - free blocks : %lld\n", ret, (long long) wb_bytes,
+					(long long) fs.icache.wb_bytes, (long long) disk.header->free_blocks);
+			}
+			else if (strcmp(cmd1, SYS_FORMAT) == 0) {
+				if (filehandle != NULL) iNodeFS_close(filehandle);
+				filehandle = NULL;
+				iNodeFS_unmount(&fs, dirhandle);
+				iNodeFS_formatInodes(&fs, atoi(cmd2));
+				dirhandle = iNodeFS_init(&fs, &disk);
+				if (dirhandle == NULL) {
+					printf (RED "FORMAT FAILED - formatting with the default iNode table\n" COLOR_RESET);
+					iNodeFS_format(&fs);
+					dirhandle = iNodeFS_init(&fs, &disk);
+				}
+				ret = 0;
+				printf ("num_inodes : %d - free blocks : %lld\n", fs.super->num_inodes, (long long) disk.header->free_blocks);
+			}
 			else if (strcmp(cmd1, SYS_HELP) == 0) {
 				
 				printf (YELLOW " GENERAL\n" COLOR_RESET
 				SYS_SHOW"       : show status of File System\n"
 				SYS_HELP"         : show list of commands\n"
+				SYS_SYNC"         : writes back the modified iNodes and the write-back buffers\n"
+				SYS_FORMAT" [n]     : formats the disk with a table of n iNodes (everything is lost)\n"
 				DIR_REMOVE" [obj]     : removes the object named 'obj'\n"
 				YELLOW "\n DIR\n" COLOR_RESET
 				DIR_SHOW"        : show actual directory info\n"
 				DIR_CHANGE" [dir]     : goes into directory named 'dir'\n"
 				DIR_MAKE" [dir]  : creates a directory named 'dir'\n"
 				DIR_LS"           : prints the dir's content\n"
+				DIR_INDEX" [n]     : indexes the dir with n hash buckets (0 removes the index)\n"
+				PATH_LOOKUP" [path]  : finds the iNode of 'path', absolute or from the dir ('.' and '..' allowed)\n"
 				YELLOW "\n FILE\n" COLOR_RESET
 				FILE_SHOW"          : show the last opened file\n"
 				FILE_MAKE" [fil]   : create a file named 'fil' \n"
 				FILE_MAKE_N" [n]    : create n files\n"
 				FILE_OPEN" [fil]    : open file named 'fil' \n"
+				PATH_OPEN" [path]   : open the file at 'path', absolute or from the dir ('.' and '..' allowed)\n"
 				FILE_WRITE" [txt]   : writes 'txt' in the last opened file\n"
 				FILE_READ"           : open the current file \n"
 				FILE_SEEK" [n]      : moves the cursor at pos n in the opened file\n"
+				FILE_PREAD" [o] [n] : reads n bytes from pos o of the opened file, without moving the cursor\n"
+				FILE_PWRITE" [o] [txt] : writes 'txt' at pos o of the opened file, without moving the cursor\n"
 				FILE_DANTE"         : writes Divina Commedia into the file\n"
 				FILE_OMERO"         : writes Iliad into the file\n"
 				FILE_LONG" [n]      : writes (Dante + Omero - 4) * n times\n"
+				FILE_FALLOC" [o] [n] [f] : preallocates n bytes from pos o of the opened file and reads them back.\n"
+				"                        f : 0, %d keep size, %d lazy zero, %d both\n"
+				FILE_TRUNCATE" [n]  : sets the length of the opened file to n bytes\n"
+				FILE_PUNCH" [o] [n] : clears n bytes from pos o of the opened file, freeing their blocks\n"
+				FILE_FLUSH"         : places on the disk what's in the write-back buffer of the opened file\n"
 				FILE_CLOSE"        : closes the last opened file\n"
 				
-				);
+				, FALLOC_KEEP_SIZE, FALLOC_LAZY_ZERO, FALLOC_KEEP_SIZE | FALLOC_LAZY_ZERO);
 			}
 			
 			
@@ -113,10 +155,35 @@ int main (int argc, char** argv) {
 			else if (strcmp(cmd1, DIR_LS) == 0) {
 				char* names[NUM_BLOCKS];
 				for (int i = 0; i < NUM_BLOCKS; ++i) {
-					names[i] = (char*) calloc(NAME_SIZE, 0);
+					names[i] = (char*) calloc(NAME_SIZE, sizeof(char));
 				}
 				iNodeFS_readDir(names, dirhandle);
 				iNodeFS_printArray(names, NUM_BLOCKS);
+				for (int i = 0; i < NUM_BLOCKS; ++i) {
+					free (names[i]);
+				}
+			}
+			
+			// index the dir
+			else if (strcmp(cmd1, DIR_INDEX) == 0) {
+				ret = iNodeFS_indexDir(dirhandle, atoi(cmd2));
+				if (ret == TBA) printf (RED "DIR NOT INDEXED\n" COLOR_RESET);
+				printf ("buckets : %d - dir blocks : %d - free blocks : %lld\n", dirhandle->dcb->index_buckets,
+					AUX_dir_blocks(&disk, dirhandle->dcb), (long long) disk.header->free_blocks);
+			}
+			
+			// look for a path
+			else if (strcmp(cmd1, PATH_LOOKUP) == 0) {
+				char path[2 * PATH_SIZE];
+				int ino = TBA;
+				ret = iNodeFS_absolutePath(dirhandle, cmd2, path, sizeof(path));
+				if (ret == 0) ret = iNodeFS_lookupPath(&fs, path, &ino);
+				if (ret == TBA) printf (RED "PATH '%s' DOES NOT EXIST\n" COLOR_RESET, cmd2);
+				else {
+					iNode* node = AUX_iget(&fs, ino);
+					printf ("path : %s - iNode : %d - %s\n", path, ino, (node != NULL && node->fcb.icb.node_type == DIR) ? "DIR" : "FIL");
+					AUX_iput(&fs, node);
+				}
 			}
 			
 			// delete a dir or a file
@@ -135,6 +202,7 @@ int main (int argc, char** argv) {
 			
 			// Create a file
 			else if (strcmp(cmd1, FILE_MAKE) == 0) {
+				if (filehandle != NULL) iNodeFS_close(filehandle);
 				filehandle = iNodeFS_createFile(dirhandle, cmd2);
 			}
 			
@@ -144,15 +212,28 @@ int main (int argc, char** argv) {
 				char filenames[atoi(cmd2)][NAME_SIZE];
 				for (int i = 0; i < atoi(cmd2); ++i) {
 					gen_filename(filenames[i], i);
+					if (filehandle != NULL) iNodeFS_close(filehandle);
 					filehandle = iNodeFS_createFile(dirhandle, filenames[i]);
 				}
 			}
 			
 			// open a file
 			else if (strcmp(cmd1, FILE_OPEN) == 0) {
+				if (filehandle != NULL) iNodeFS_close(filehandle);
 				filehandle = iNodeFS_openFile(dirhandle, cmd2);
 			}
 			
+			// open a file by its path
+			else if (strcmp(cmd1, PATH_OPEN) == 0) {
+				char path[2 * PATH_SIZE];
+				if (filehandle != NULL) iNodeFS_close(filehandle);
+				filehandle = NULL;
+				if (iNodeFS_absolutePath(dirhandle, cmd2, path, sizeof(path)) == 0) filehandle = iNodeFS_openPath(&fs, path);
+				ret = (filehandle == NULL) ? TBA : 0;
+				if (ret == TBA) printf (RED "FILE '%s' NOT OPENED\n" COLOR_RESET, cmd2);
+				else printf ("opened : %s\n", path);
+			}
+			
 			// write a file
 			else if (strcmp(cmd1, FILE_WRITE) == 0) {
 				int c = 0;
@@ -181,40 +262,118 @@ int main (int argc, char** argv) {
 				if (atoi(cmd2) > NUM_BLOCKS) printf (RED "TOO LARGE FILE\n" COLOR_RESET);
 				for (int i = 0; i < atoi(cmd2); ++i) {
 					ret = iNodeFS_write(filehandle, "@@@@@", 5);
-					filehandle->pos_in_block -= 1;
+					filehandle->pos_in_file -= 1;
 					ret = iNodeFS_write(filehandle, dante, sizeof(dante));
-					filehandle->pos_in_block -= 1;
+					filehandle->pos_in_file -= 1;
 					ret = iNodeFS_write(filehandle, "#####", 5);
-					filehandle->pos_in_block -= 1;
+					filehandle->pos_in_file -= 1;
 					ret = iNodeFS_write(filehandle, omero, sizeof(omero));
-					filehandle->pos_in_block -= 1;
+					filehandle->pos_in_file -= 1;
 				}
 			}
 		
 			// seek
 			else if (strcmp(cmd1, FILE_SEEK) == 0) {
-				ret = iNodeFS_seek(filehandle, atoi(cmd2));
-				printf ("Pointer moved in pos : %d\n", ret);
+				int64_t pos = iNodeFS_seek(filehandle, atoll(cmd2));
+				ret = (pos == TBA) ? TBA : 0;
+				printf ("Pointer moved in pos : %lld\n", (long long) pos);
 			}
 			
 			// read a file
 			else if (strcmp(cmd1, FILE_READ) == 0 && filehandle != NULL) {
-				int cmd_len = filehandle->fcb->num_entries;
-				char text[cmd_len];
-				for (int i = 0; i < cmd_len; ++i) text[i] = 0;
-				ret = iNodeFS_read(filehandle, text, cmd_len);
-				printf ("%s\n", text);
-				printf ("read bytes : %d\n", ret);
+				int64_t size = filehandle->fcb->num_entries;
+				char* text = (char*) calloc(size + 1, 1);
+				int64_t read_data = (text != NULL) ? iNodeFS_read(filehandle, text, size) : TBA;
+				ret = (read_data == TBA) ? TBA : 0;
+				if (text != NULL) printf ("%s\n", text);
+				printf ("read bytes : %lld\n", (long long) read_data);
+				free (text);
+			}
+			
+			// read from a position, without moving the cursor
+			else if (strcmp(cmd1, FILE_PREAD) == 0 && filehandle != NULL) {
+				long long offset = 0;
+				long long size = 0;
+				sscanf(line, "%*s %lld %lld", &offset, &size);
+				if (size > filehandle->fcb->num_entries) size = filehandle->fcb->num_entries;
+				if (size < 0) size = 0;
+				char* text = (char*) malloc(size + 1);
+				int64_t read_data = (text != NULL) ? iNodeFS_pread(filehandle, text, size, offset) : TBA;
+				if (read_data > 0) iNodeFS_printData(text, read_data);
+				ret = (read_data == TBA) ? TBA : 0;
+				free (text);
+				printf ("read bytes : %lld from pos %lld - cursor in pos : %lld\n", (long long) read_data, offset, (long long) filehandle->pos_in_file);
+			}
+			
+			// write at a position, without moving the cursor
+			else if (strcmp(cmd1, FILE_PWRITE) == 0 && filehandle != NULL) {
+				long long offset = 0;
+				char text[MAX_CMD_LEN] = "";
+				sscanf(line, "%*s %lld %s", &offset, text);
+				int64_t written_data = iNodeFS_pwrite(filehandle, text, strlen(text), offset);
+				ret = written_data;
+				printf ("written bytes : %lld at pos %lld - cursor in pos : %lld\n", (long long) written_data, offset, (long long) filehandle->pos_in_file);
+			}
+			
+			// preallocate and read back
+			else if (strcmp(cmd1, FILE_FALLOC) == 0 && filehandle != NULL) {
+				long long offset = 0;
+				long long size = 0;
+				int flags = 0;
+				sscanf(line, "%*s %lld %lld %d", &offset, &size, &flags);
+				int64_t free_blocks = disk.header->free_blocks;
+				ret = iNodeFS_fallocate(filehandle, offset, size, flags);
+				printf ("falloc : %d - free blocks : %lld -> %lld - size : %lld - valid bytes : %lld\n", ret, (long long) free_blocks,
+					(long long) disk.header->free_blocks, (long long) filehandle->fcb->num_entries, (long long) filehandle->fcb->valid_bytes);
+				
+				// The preallocated bytes read as zeros
+				char* text = (ret == 0) ? (char*) malloc(size) : NULL;
+				int64_t read_data = (text != NULL) ? iNodeFS_pread(filehandle, text, size, offset) : 0;
+				int64_t zeros = 0;
+				for (int64_t i = 0; i < read_data; ++i) {
+					if (text[i] == '\0') ++zeros;
+				}
+				if (ret == 0) printf ("read back : %lld bytes from pos %lld - zeros : %lld\n", (long long) read_data, offset, (long long) zeros);
+				free (text);
+			}
+			
+			// cut or extend a file
+			else if (strcmp(cmd1, FILE_TRUNCATE) == 0 && filehandle != NULL) {
+				ret = iNodeFS_truncate(filehandle, atoll(cmd2));
+				iNodeFS_printFile(filehandle);
+			}
+			
+			// punch a hole in a file
+			else if (strcmp(cmd1, FILE_PUNCH) == 0 && filehandle != NULL) {
+				long long offset = 0;
+				long long size = 0;
+				sscanf(line, "%*s %lld %lld", &offset, &size);
+				ret = iNodeFS_punchHole(filehandle, offset, size);
+				iNodeFS_printFile(filehandle);
+			}
+			
+			// place the write-back buffer on the disk
+			else if (strcmp(cmd1, FILE_FLUSH) == 0 && filehandle != NULL) {
+				int64_t wb_bytes = fs.icache.wb_bytes;
+				int64_t free_blocks = disk.header->free_blocks;
+				ret = iNodeFS_flush(filehandle);
+				printf ("write-back bytes : %lld -> %lld - free blocks : %lld -> %lld\n", (long long) wb_bytes,
+					(long long) fs.icache.wb_bytes, (long long) free_blocks, (long long) disk.header->free_blocks);
 			}
 			
 			// Close a file
 			else if (strcmp(cmd1, FILE_CLOSE) == 0) {
+				iNodeFS_close(filehandle);
 				filehandle = NULL;
 			}
 			
 			// Quit
 			else if (strcmp(cmd1, "quit") == 0) {
 				printf (YELLOW "Shell exited with return status %d\n" COLOR_RESET, ret);
+				if (filehandle != NULL) iNodeFS_close(filehandle);
+				iNodeFS_unmount(&fs, dirhandle);
+				DiskDriver_unmap(&disk);
+				free (line);
 				break;
 			}
 			
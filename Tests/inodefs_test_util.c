@@ -7,11 +7,26 @@ void iNodeFS_print (iNodeFS* fs, DirectoryHandle* d) {
 	printf ("-------- DISK DRIVER --------    iNodeFS_print()\n");
 	DiskDriver* disk = fs->disk;
 	printf ("Header\n");
-	printf ("num_blocks	        : %d\n", disk->header->num_blocks);
-	printf ("bitmap_blocks		: %d\n", disk->header->bitmap_blocks);
-	printf ("bitmap_entries		: %d\n", disk->header->bitmap_entries);
-	printf ("free_blocks		: %d\n", disk->header->free_blocks);
-	printf ("first_free_block	: %d\n", disk->header->first_free_block);
+	printf ("version			: %u\n", disk->header->version);
+	printf ("block_size		: %d\n", disk->header->block_size);
+	printf ("num_blocks	        : %lld\n", (long long) disk->header->num_blocks);
+	printf ("bitmap_blocks		: %lld\n", (long long) disk->header->bitmap_blocks);
+	printf ("bitmap_entries		: %lld\n", (long long) disk->header->bitmap_entries);
+	printf ("free_blocks		: %lld\n", (long long) disk->header->free_blocks);
+	printf ("first_free_block	: %lld\n", (long long) disk->header->first_free_block);
+	printf ("group_blocks		: %d\n", disk->header->group_blocks);
+	printf ("num_groups		: %d\n", disk->num_groups);
+	printf ("num_inodes		: %d\n", fs->super->num_inodes);
+	printf ("free_inodes		: %d\n", fs->super->free_inodes);
+	printf ("dcache hits		: %d\n", fs->dcache.hits);
+	printf ("dcache misses		: %d\n", fs->dcache.misses);
+	printf ("dcache prefix hits	: %d\n", fs->dcache.prefix_hits);
+	printf ("icache nodes		: %d\n", fs->icache.cached);
+	printf ("icache hits		: %d\n", fs->icache.hits);
+	printf ("icache misses		: %d\n", fs->icache.misses);
+	printf ("write-back bytes	: %lld\n", (long long) fs->icache.wb_bytes);
+	printf ("pool blocks		: %d\n", fs->pool.blocks);
+	printf ("pool handles		: %d\n", fs->pool.handles);
 	
 	for (int i = 0; i < disk->header->bitmap_entries; ++i) {
 		printf ("[ %d ] ", disk->bitmap_data[i]);
@@ -26,46 +41,44 @@ void iNodeFS_printHandle (void* h) {
 		printf ("GIVEN HANDLER IS NULL\n");
 		return;
 	}
+	char name[NAME_SIZE];
 	if (((DirectoryHandle*) h)->dcb->fcb.icb.node_type == DIR) {
 		DirectoryHandle* handle = (DirectoryHandle*) h;
+		iNodeFS_nodeName(handle->infs, handle->dcb, name);
 		printf ("-- You are now working in \n");
-		printf ("Directory             : %s\n", handle->dcb->fcb.name);
+		printf ("Directory             : %s\n", name);
 		printf ("Size in Blocks        : %d\n", handle->dcb->fcb.size_in_blocks);
-		printf ("Single Indirect       : %d\n", handle->dcb->single_indirect);
-		printf ("Double Indirect       : %d\n", handle->dcb->double_indirect);
-		printf ("Size in Bytes         : %d\n", handle->dcb->fcb.size_in_bytes);
+		printf ("Extents               : %d\n", handle->dcb->num_extents);
+		printf ("Extent tree depth     : %d\n", handle->dcb->depth);
+		printf ("Size in Bytes         : %lld\n", (long long) handle->dcb->fcb.size_in_bytes);
 		printf ("Is Dir?               : %d\n", handle->dcb->fcb.icb.node_type);
-		if (handle->indirect != NULL)
-			printf ("Current indirect      : %d\n", handle->indirect->header.block_in_disk);
 		printf ("Current Block         : %d\n", handle->current_block->block_in_disk);
-		printf ("Block in disk         : %d\n", handle->dcb->header.block_in_disk);
+		printf ("iNode                 : %d\n", handle->dcb->header.block_in_disk);
 		printf ("Block in file         : %d\n", handle->current_block->block_in_file);
-		if (handle->directory != NULL) 
-			printf ("This dir's parent is  : %s\n", handle->directory->fcb.name);
+		if (handle->directory != NULL && iNodeFS_nodeName(handle->infs, handle->directory, name) == 0) 
+			printf ("This dir's parent is  : %s\n", name);
 		else printf ("This dir is root\n");
-		printf ("Files in this folder  : %d\n", handle->dcb->num_entries);
+		printf ("Files in this folder  : %lld\n", (long long) handle->dcb->num_entries);
 		printf ("Position in node      : %d\n", handle->pos_in_node);
 		printf ("Position in block     : %d\n", handle->pos_in_block);
 	}
 	if (((FileHandle*) h)->fcb->fcb.icb.node_type == FIL) {
 		FileHandle* handle = (FileHandle*) h;
+		iNodeFS_nodeName(handle->infs, handle->fcb, name);
 		printf ("-- You are now working in \n");
-		printf ("File                 : %s\n", handle->fcb->fcb.name);
+		printf ("File                 : %s\n", name);
 		printf ("Size in Blocks        : %d\n", handle->fcb->fcb.size_in_blocks);
-		printf ("Single Indirect       : %d\n", handle->fcb->single_indirect);
-		printf ("Double Indirect       : %d\n", handle->fcb->double_indirect);
-		printf ("Size in Bytes         : %d\n", handle->fcb->fcb.size_in_bytes);
+		printf ("Extents               : %d\n", handle->fcb->num_extents);
+		printf ("Extent tree depth     : %d\n", handle->fcb->depth);
+		printf ("Inline data           : %d\n", handle->fcb->depth == INLINE);
+		printf ("Size in Bytes         : %lld\n", (long long) handle->fcb->fcb.size_in_bytes);
 		printf ("Is Dir?               : %d\n", handle->fcb->fcb.icb.node_type);
-		if (handle->indirect != NULL)
-			printf ("Current indirect      : %d\n", handle->indirect->header.block_in_disk);
-		printf ("Current Block         : %d\n", handle->current_block->block_in_disk);
-		printf ("Block in disk         : %d\n", handle->current_block->block_in_disk);
-		printf ("Block in file         : %d\n", handle->current_block->block_in_file);
-		printf ("Parent dir's block    : %d\n", handle->fcb->fcb.icb.directory_block); 
-		//printf ("Pos in file           : %d\n", handle->pos_in_file);
-		printf ("Data size             : %d\n", handle->fcb->num_entries);
-		printf ("Position in node      : %d\n", handle->pos_in_node);
-		printf ("Position in block     : %d\n", handle->pos_in_block);
+		printf ("iNode                 : %d\n", handle->fcb->header.block_in_disk);
+		printf ("Block in file         : %lld\n", (long long) (handle->pos_in_file >> handle->infs->disk->block_shift));
+		printf ("Parent dir's iNode    : %d\n", handle->fcb->fcb.icb.directory_block); 
+		printf ("Pos in file           : %lld\n", (long long) handle->pos_in_file);
+		printf ("Data size             : %lld\n", (long long) handle->fcb->num_entries);
+		printf ("Valid data size       : %lld\n", (long long) handle->fcb->valid_bytes);
 	}
 	
 }
@@ -88,3 +101,140 @@ void iNodeFS_printArray (char** a, int len) {
 	}
 	printf ("]\n");
 }
+
+// Prints the content of the file of f (the zero bytes as '.'), its size, its blocks and the free blocks of the disk
+void iNodeFS_printFile (FileHandle* f) {
+	if (f == NULL) return;
+	int64_t size = f->fcb->num_entries;
+	char* text = (char*) malloc(size + 1);
+	int64_t read_data = iNodeFS_pread(f, text, size, 0);
+	if (read_data > 0) iNodeFS_printData(text, read_data);
+	free (text);
+	printf ("size : %lld - blocks : %d - free blocks : %lld\n", (long long) size, f->fcb->fcb.size_in_blocks,
+		(long long) f->infs->disk->header->free_blocks);
+}
+
+// Stores in out (len bytes) the absolute path of path: path itself if it starts with '/', else path after
+// the one of the current directory of d, rebuilt walking up its parents
+// returns 0 on success, -1 on error (or if out is too short)
+int iNodeFS_absolutePath(DirectoryHandle* d, const char* path, char* out, int len) {
+	if (d == NULL || path == NULL || out == NULL) return TBA;
+	if (path[0] == '/') {
+		if ((int) strlen(path) >= len) return TBA;
+		strcpy(out, path);
+		return 0;
+	}
+	
+	// Putting the name of each directory in front, up to the top level one
+	char name[NAME_SIZE];
+	char aux[len];
+	int ret = (snprintf(out, len, "/%s", path) < len) ? 0 : TBA;
+	iNode* voyager = d->dcb;
+	AUX_iref(voyager);
+	while (ret == 0 && voyager != NULL && voyager->fcb.icb.directory_block != TBA) {
+		if (iNodeFS_nodeName(d->infs, voyager, name) == TBA || snprintf(aux, len, "/%s%s", name, out) >= len) ret = TBA;
+		else {
+			strcpy(out, aux);
+			iNode* parent = AUX_iget(d->infs, voyager->fcb.icb.directory_block);
+			AUX_iput(d->infs, voyager);
+			voyager = parent;
+		}
+	}
+	if (voyager == NULL) ret = TBA;
+	AUX_iput(d->infs, voyager);
+	
+	return ret;
+}
+
+// Prints len bytes of data, the zero bytes (holes, preallocated blocks) as '.'
+// returns the number of zero bytes
+int64_t iNodeFS_printData (const char* data, int64_t len) {
+	int64_t zeros = 0;
+	for (int64_t i = 0; i < len; ++i) {
+		if (data[i] == '\0') ++zeros;
+		putchar ((data[i] == '\0') ? '.' : data[i]);
+	}
+	printf ("\n");
+	return zeros;
+}
+
+// Looks for the first bit having status "status" from the cell start a cell at a time,
+// and in a cell a bit at a time: the scan BitMap_get did before its kernels
+int BitMap_getBytewise(BitMap* bmap, int start, int status) {
+	for (int i = start; i < bmap->num_bits; ++i) {
+		for (int bit = NUMBITS - 1; bit >= 0; --bit) {
+			int set = (bmap->entries[i] >> bit) & 1;
+			if (set == (status != 0)) return i * NUMBITS + (NUMBITS - 1 - bit);
+		}
+	}
+	return ERROR_RESEARCH_FAULT;
+}
+
+// fills len cells with random bytes. Most of them are all FREE or all OCCUPIED,
+// so that there are long runs for the kernels to skip
+static void AUX_random_cells(uint8_t* cells, int len) {
+	int bias = rand() % 4;
+	for (int i = 0; i < len; ++i) {
+		int r = rand() % 16;
+		if (r < 2) cells[i] = rand() & 0xFF;
+		else if (bias == 0) cells[i] = 0x00;
+		else if (bias == 1) cells[i] = 0xFF;
+		else cells[i] = (r % 2) ? 0x00 : 0xFF;
+	}
+}
+
+// Compares the search kernels of BitMap_get (word, AVX2 if the CPU has it, summary)
+// with the byte-wise scan on rounds random bitmaps, with unaligned starts, ends and addresses
+// returns the number of mismatches
+int BitMap_checkKernels(int rounds) {
+	int mismatches = 0;
+	int avx2 = 0;
+#if BITMAP_X86_KERNELS
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+	srand(1);
+	
+	for (int round = 0; round < rounds; ++round) {
+		
+		// A bitmap of any length, at any address
+		int num_bits = 1 + rand() % 300;
+		int shift = rand() % 32;
+		uint8_t* buffer = (uint8_t*) malloc(num_bits + shift);
+		BitMap bmap;
+		bmap.num_bits = num_bits;
+		bmap.entries = buffer + shift;
+		bmap.summary = NULL;
+		AUX_random_cells(bmap.entries, num_bits);
+		
+		// The same bitmap, searched through its summary
+		BitMap summed = bmap;
+		BitMap_buildSummary(&summed);
+		
+		for (int status = FREE; status <= OCCUPIED; ++status) {
+			for (int start = 0; start < num_bits; ++start) {
+				int expected = BitMap_getBytewise(&bmap, start, status);
+				int found[3] = { BitMap_getWord(&bmap, start, status), expected, expected };
+				const char* kernels[3] = { "word", "avx2", "summary" };
+#if BITMAP_X86_KERNELS
+				if (avx2) found[1] = BitMap_getAVX2(&bmap, start, status);
+#endif
+				found[2] = BitMap_get(&summed, start, status);
+				
+				for (int k = 0; k < 3; ++k) {
+					if (found[k] == expected) continue;
+					if (mismatches < 10) {
+						printf (RED "MISMATCH : %s kernel, %d cells, start %d, status %d : %d instead of %d\n" COLOR_RESET,
+							kernels[k], num_bits, start, status, found[k], expected);
+					}
+					++mismatches;
+				}
+			}
+		}
+		BitMap_freeSummary(&summed);
+		free(buffer);
+	}
+	
+	printf ("kernels checked on %d bitmaps (avx2 : %d) - mismatches : %d\n", rounds, avx2, mismatches);
+	return mismatches;
+}
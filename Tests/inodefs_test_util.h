@@ -5,6 +5,7 @@
 #define NUM_BLOCKS 	1000
 #define NUM_FILES	400
 #define MAX_CMD_LEN	128
+#define BITMAP_ROUNDS	2000
 #define BACK		".."
 
 #define FILE_0	"Hell0"
@@ -25,6 +26,8 @@
 
 #define SYS_SHOW	"status"
 #define SYS_HELP	"help"
+#define SYS_SYNC	"sync"
+#define SYS_FORMAT	"format"
 
 #define DIR_SHOW	"where"
 #define DIR_CHANGE	"cd"
@@ -32,6 +35,9 @@
 #define DIR_MAKE_N	"mkndir"
 #define DIR_LS		"ls"
 #define DIR_REMOVE	"rm"
+#define DIR_INDEX	"index"
+#define PATH_LOOKUP	"lookup"
+#define PATH_OPEN	"popen"
 
 #define	FILE_MAKE	"mkfil"
 #define	FILE_MAKE_N	"mknfil"
@@ -44,6 +50,12 @@
 #define FILE_DANTE	"dante"
 #define FILE_OMERO	"omero"
 #define FILE_LONG	"long"
+#define FILE_PREAD	"pread"
+#define FILE_PWRITE	"pwrite"
+#define FILE_FLUSH	"flush"
+#define FILE_FALLOC	"falloc"
+#define FILE_TRUNCATE	"truncate"
+#define FILE_PUNCH	"punch"
 
 char dante[] = "Nel mezzo del cammin di nostra vita mi ritrovai per una selva oscura ché la diritta via era smarrita.Ahi quanto a dir qual era è cosa dura esta selva selvaggia e aspra e forte che nel pensier rinova la paura! Tant'è amara che poco è più morte; ma per trattar del ben ch'i' vi trovai, dirò de l'altre cose ch'i' v'ho scorte. Io non so ben ridir com'i' v'intrai, tant'era pien di sonno a quel punto che la verace via abbandonai. Ma poi ch'i' fui al piè d'un colle giunto, là dove terminava quella valle che m'avea di paura il cor compunto, guardai in alto, e vidi le sue spalle vestite già de' raggi del pianeta che mena dritto altrui per ogne calle. Allor fu la paura un poco queta che nel lago del cor m'era durata la notte ch'i' passai con tanta pieta. E come quei che con lena affannata uscito fuor del pelago a la riva si volge a l'acqua perigliosa e guata, così l'animo mio, ch'ancor fuggiva, si volse a retro a rimirar lo passo che non lasciò già mai persona viva.";
 
@@ -66,3 +78,24 @@ void gen_dirname(char *s, int i);
 
 // Prints an array of strings
 void iNodeFS_printArray (char** a, int len);
+
+// Prints the content of the file of f (the zero bytes as '.'), its size, its blocks and the free blocks of the disk
+void iNodeFS_printFile (FileHandle* f);
+
+// Stores in out (len bytes) the absolute path of path: path itself if it starts with '/', else path after
+// the one of the current directory of d, rebuilt walking up its parents
+// returns 0 on success, -1 on error (or if out is too short)
+int iNodeFS_absolutePath(DirectoryHandle* d, const char* path, char* out, int len);
+
+// Prints len bytes of data, the zero bytes (holes, preallocated blocks) as '.'
+// returns the number of zero bytes
+int64_t iNodeFS_printData (const char* data, int64_t len);
+
+// Looks for the first bit having status "status" from the cell start a cell at a time,
+// and in a cell a bit at a time: the scan BitMap_get did before its kernels
+int BitMap_getBytewise(BitMap* bmap, int start, int status);
+
+// Compares the search kernels of BitMap_get (word, AVX2 if the CPU has it, summary)
+// with the byte-wise scan on rounds random bitmaps, with unaligned starts, ends and addresses
+// returns the number of mismatches
+int BitMap_checkKernels(int rounds);